@@ -0,0 +1,465 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "compiledRom.hpp"
+#include "cpu.hpp"
+#include "disassembler.hpp"
+#include "hash.hpp"
+
+/// chip8-aot: static recompiler from a .ch8 ROM to a C++ translation unit.
+///
+/// The control flow graph is recovered from the jumps, calls, returns and
+/// skips reachable from the starting address. Every reached instruction
+/// becomes a label, straight-line code flows from label to label and static
+/// branches are gotos. Returns and Bnnn go through a switch on the pc, and
+/// any pc outside of the compiled code hands control back to the CPU, which
+/// interprets it. So does a ROM that writes over its own code, which the
+/// CPU tells from writes to its data with the bitmap of the compiled bytes.
+
+enum class Flow {
+    Next,
+    Jump,
+    Call,
+    Return,
+    Skip,
+    Computed,
+    WaitKey,
+    Store,
+    Halt
+};
+
+struct ROMImage {
+    std::vector<uint8_t> bytes;
+    uint16_t begin;
+    uint16_t end;
+
+    bool contains(unsigned int address) const {
+        return address >= begin && address + 1 < end;
+    }
+
+    uint16_t fetch(unsigned int address) const {
+        return (bytes[address - begin] << 8u) | bytes[address - begin + 1];
+    }
+};
+
+static std::string hex(unsigned int value, int digits) {
+    char buffer[16];
+    std::snprintf(buffer, sizeof(buffer), "0x%0*X", digits, value);
+
+    return buffer;
+}
+
+static std::string label(unsigned int address) {
+    char buffer[16];
+    std::snprintf(buffer, sizeof(buffer), "L%03X", address);
+
+    return buffer;
+}
+
+/// Mirrors the way the opcode tables of the CPU resolve an opcode
+static Flow classify(uint16_t opcode) {
+    switch(opcode & 0xF000u) {
+        case 0x0000:
+            switch(opcode & 0x00FFu) {
+                case 0xEE:
+                    return Flow::Return;
+                case 0xFD:
+                    return Flow::Halt;
+            }
+            return Flow::Next;
+        case 0x1000:
+            return Flow::Jump;
+        case 0x2000:
+            return Flow::Call;
+        case 0x5000:
+            switch(opcode & 0x000Fu) {
+                case 0x0:
+                    return Flow::Skip;
+                case 0x2:
+                    return Flow::Store;
+            }
+            return Flow::Next;
+        case 0x3000:
+        case 0x4000:
+        case 0x9000:
+            return Flow::Skip;
+        case 0xB000:
+            return Flow::Computed;
+        case 0xE000:
+            if((opcode & 0x000Fu) == 0xE || (opcode & 0x000Fu) == 0x1) {
+                return Flow::Skip;
+            }
+            return Flow::Next;
+        case 0xF000:
+            switch(opcode & 0x00FFu) {
+                case 0x0A:
+                    return Flow::WaitKey;
+                case 0x33:
+                case 0x55:
+                    return Flow::Store;
+            }
+            return Flow::Next;
+        default:
+            return Flow::Next;
+    }
+}
+
+static std::set<unsigned int> recoverCode(const ROMImage& rom) {
+    std::set<unsigned int> code;
+    std::vector<unsigned int> worklist = { rom.begin };
+
+    while(!worklist.empty()) {
+        unsigned int address = worklist.back();
+        worklist.pop_back();
+
+        if(!rom.contains(address) || !code.insert(address).second) {
+            continue;
+        }
+
+        uint16_t opcode = rom.fetch(address);
+
+        switch(classify(opcode)) {
+            case Flow::Jump:
+                worklist.push_back(opcode & 0x0FFFu);
+                break;
+            case Flow::Call:
+                // The subroutine returns right after the call
+                worklist.push_back(opcode & 0x0FFFu);
+                worklist.push_back(address + 2);
+                break;
+            case Flow::Skip:
+                worklist.push_back(address + 2);
+                worklist.push_back(address + 4);
+                break;
+            case Flow::Return:
+            case Flow::Computed:
+            case Flow::Halt:
+                break;
+            default:
+                worklist.push_back(address + 2);
+        }
+    }
+
+    return code;
+}
+
+class Emitter {
+private:
+    const ROMImage& rom;
+    const std::set<unsigned int>& code;
+    std::ostream& out;
+
+    // The instructions, written after the dispatch switch, which is only
+    // labeled when some of them jump back to it
+    std::ostringstream body;
+    bool dispatched = false;
+
+public:
+    Emitter(const ROMImage& rom, const std::set<unsigned int>& code, std::ostream& out):
+        rom(rom), code(code), out(out) {}
+
+    void emit(const std::string& name, const std::string& symbol) {
+        out << "// Generated by chip8-aot from " << name << ", do not edit.\n"
+            << "\n"
+            << "#include \"compiledRom.hpp\"\n"
+            << "\n"
+            << "#define BEGIN(address) if(count == 0) { pc = address; return 0; } --count\n"
+            << "#define RETIRE(address, opcode) A::retire(cpu, address, opcode)\n"
+            << "\n"
+            << "namespace {\n"
+            << "\n"
+            << "typedef CompiledAccess A;\n"
+            << "\n"
+            << "unsigned int run(CPU& cpu, unsigned int count) {\n"
+            << "    uint8_t* V = A::registers(cpu);\n"
+            << "    uint16_t* stack = A::stack(cpu);\n"
+            << "    uint16_t& I = A::I(cpu);\n"
+            << "    uint16_t& pc = A::pc(cpu);\n"
+            << "    uint8_t& sp = A::sp(cpu);\n"
+            << "    uint8_t& DT = A::delayTimer(cpu);\n"
+            << "    uint8_t& ST = A::soundTimer(cpu);\n"
+            << "    uint8_t* keyboard = cpu.keyboard;\n"
+            << "    (void)V; (void)stack; (void)I; (void)sp; (void)DT; (void)ST; (void)keyboard;\n"
+            << "\n";
+
+        for(auto it = code.begin(); it != code.end(); ++it) {
+            auto next = std::next(it);
+            unsigned int following = next == code.end() ? 0 : *next;
+
+            emitInstruction(*it, following);
+        }
+
+        if(dispatched) {
+            out << "dispatch:\n";
+        }
+
+        out << "    switch(pc) {\n";
+
+        for(unsigned int address: code) {
+            out << "        case " << hex(address, 3) << ": goto " << label(address) << ";\n";
+        }
+
+        out << "        default: return count;\n"
+            << "    }\n"
+            << body.str();
+
+        // The bytes of every compiled instruction, and the ram they hash
+        uint8_t bitmap[CPU::RAM_SIZE / 8] = {};
+        uint8_t ram[CPU::RAM_SIZE] = {};
+        std::copy(rom.bytes.begin(), rom.bytes.end(), ram + rom.begin);
+
+        for(unsigned int address: code) {
+            bitmap[address >> 3] |= 1u << (address & 0x7);
+            bitmap[(address + 1) >> 3] |= 1u << ((address + 1) & 0x7);
+        }
+
+        out << "}\n"
+            << "\n"
+            << "const uint8_t code[" << sizeof(bitmap) << "] = {";
+
+        for(unsigned int i = 0; i < sizeof(bitmap); ++i) {
+            out << (i % 16 == 0 ? "\n    " : " ") << hex(bitmap[i], 2) << ",";
+        }
+
+        out << "\n"
+            << "};\n"
+            << "\n"
+            << "}\n"
+            << "\n"
+            << "extern const CompiledROM " << symbol << " = {\n"
+            << "    \"" << name << "\", " << hex(rom.begin, 3) << ", " << hex(rom.end, 3) << ", code, "
+            << "0x" << std::hex << CompiledROM::hashCode(ram, bitmap)
+            << std::dec << "ull, &run\n"
+            << "};\n";
+    }
+
+private:
+    std::string exitTo(unsigned int address) {
+        if(code.count(address)) {
+            return "goto " + label(address) + ";";
+        }
+
+        return "{ pc = " + hex(address, 3) + "; return count; }";
+    }
+
+    void emitInstruction(unsigned int address, unsigned int following) {
+        uint16_t opcode = rom.fetch(address);
+        std::string x = hex((opcode >> 8) & 0xFu, 1);
+        std::string y = hex((opcode >> 4) & 0xFu, 1);
+        std::string kk = hex(opcode & 0x00FFu, 2);
+        std::string nnn = hex(opcode & 0x0FFFu, 3);
+        unsigned int next = address + 2;
+        std::string retire = "RETIRE(" + hex(address, 3) + ", " + hex(opcode, 4) + ");";
+
+        body << "\n"
+            << label(address) << ": // " << hex(opcode, 4) << "  " << disassemble(opcode) << "\n"
+            << "    BEGIN(" << hex(address, 3) << ");\n";
+
+        switch(classify(opcode)) {
+            case Flow::Jump:
+                body << "    " << retire << "\n"
+                    << "    " << exitTo(opcode & 0x0FFFu) << "\n";
+                return;
+            case Flow::Call:
+                // Halts on a full stack, like CPU::opcode2nnn
+                body << "    if(sp == A::STACK_SIZE) { " << retire << " " << exitTo(address) << " }\n"
+                    << "    stack[sp++] = " << hex(next, 3) << ";\n"
+                    << "    " << retire << "\n"
+                    << "    " << exitTo(opcode & 0x0FFFu) << "\n";
+                return;
+            case Flow::Halt:
+                // 00FD runs again and again
+                body << "    " << retire << "\n"
+                    << "    " << exitTo(address) << "\n";
+                return;
+            case Flow::Return:
+                body << "    if(sp == 0) { " << retire << " " << exitTo(address) << " }\n"
+                    << "    pc = stack[--sp];\n"
+                    << "    " << retire << "\n"
+                    << "    goto dispatch;\n";
+                dispatched = true;
+                return;
+            case Flow::Computed:
+                body << "    pc = " << hex(next, 3) << ";\n"
+                    << "    A::execute(cpu, " << hex(opcode, 4) << ");\n"
+                    << "    " << retire << "\n"
+                    << "    goto dispatch;\n";
+                dispatched = true;
+                return;
+            case Flow::Skip:
+                body << "    " << retire << "\n"
+                    << "    if(" << skipCondition(opcode, x, y, kk) << ") "
+                    << exitTo(address + 4) << "\n"
+                    << "    " << exitTo(next) << "\n";
+                return;
+            case Flow::WaitKey:
+                body << "    {\n"
+                    << "        bool pressed = false;\n"
+                    << "        for(int i = 0; i < 16 && !pressed; ++i) {\n"
+                    << "            if(keyboard[i]) {\n"
+                    << "                V[" << x << "] = i;\n"
+                    << "                pressed = true;\n"
+                    << "            }\n"
+                    << "        }\n"
+                    << "        " << retire << "\n"
+                    << "        if(!pressed) " << exitTo(address) << "\n"
+                    << "    }\n";
+                break;
+            case Flow::Store:
+                body << "    A::execute(cpu, " << hex(opcode, 4) << ");\n"
+                    << "    " << retire << "\n"
+                    << "    if(!A::compiled(cpu)) { pc = " << hex(next, 3) << "; return count; }\n";
+                break;
+            default:
+                body << "    " << statement(opcode, x, y, kk, nnn) << "\n"
+                    << "    " << retire << "\n";
+        }
+
+        if(following != next) {
+            body << "    " << exitTo(next) << "\n";
+        }
+    }
+
+    std::string skipCondition(uint16_t opcode, const std::string& x,
+                              const std::string& y, const std::string& kk) {
+        switch(opcode & 0xF000u) {
+            case 0x3000:
+                return "V[" + x + "] == " + kk;
+            case 0x4000:
+                return "V[" + x + "] != " + kk;
+            case 0x5000:
+                return "V[" + x + "] == V[" + y + "]";
+            case 0x9000:
+                return "V[" + x + "] != V[" + y + "]";
+            default:
+                if((opcode & 0x000Fu) == 0xE) {
+                    return "keyboard[V[" + x + "] & 0xF]";
+                }
+                return "!keyboard[V[" + x + "] & 0xF]";
+        }
+    }
+
+    /// Instructions without control flow. Only those whose semantics can
+    /// not vary are inlined, the others are interpreted by the CPU.
+    std::string statement(uint16_t opcode, const std::string& x, const std::string& y,
+                          const std::string& kk, const std::string& nnn) {
+        std::string Vx = "V[" + x + "]";
+        std::string Vy = "V[" + y + "]";
+
+        switch(opcode & 0xF000u) {
+            case 0x6000:
+                return Vx + " = " + kk + ";";
+            case 0x7000:
+                return Vx + " += " + kk + ";";
+            case 0x8000:
+                switch(opcode & 0x000Fu) {
+                    case 0x0:
+                        return Vx + " = " + Vy + ";";
+                    case 0x4:
+                        return "{ uint16_t sum = " + Vx + " + " + Vy + "; "
+                               "V[0xF] = sum > 0x0FFu ? 1 : 0; " + Vx + " = sum & 0x00FFu; }";
+                    case 0x5:
+                        return "V[0xF] = " + Vx + " > " + Vy + " ? 1 : 0; " + Vx + " -= " + Vy + ";";
+                }
+                break;
+            case 0xA000:
+                return "I = " + nnn + ";";
+            case 0xF000:
+                switch(opcode & 0x00FFu) {
+                    case 0x07:
+                        return Vx + " = DT;";
+                    case 0x15:
+                        return "DT = " + Vx + ";";
+                    case 0x18:
+                        return "ST = " + Vx + ";";
+                    case 0x1E:
+                        return "I += " + Vx + ";";
+                }
+                break;
+        }
+
+        return "A::execute(cpu, " + hex(opcode, 4) + ");";
+    }
+};
+
+static std::string symbolFor(const std::string& path) {
+    std::string name = path.substr(path.find_last_of("/\\") + 1);
+    name = name.substr(0, name.find_last_of('.'));
+
+    std::string symbol = "compiledROM_";
+    for(char c: name) {
+        symbol += std::isalnum(static_cast<unsigned char>(c)) ? c : '_';
+    }
+
+    return symbol;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 3 && argc != 4) {
+        std::cerr << "Usage: "
+                  << argv[0]
+                  << " PathToROM PathToOutput.cpp [SymbolName]"
+                  << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+
+    std::ifstream file(argv[1], std::ios::binary);
+
+    if(!file.is_open()) {
+        std::cerr << "Error: cannot open " << argv[1] << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+
+    ROMImage rom;
+    rom.bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+    if(rom.bytes.size() > CPU::RAM_SIZE - CPU::STARTING_ADDRESS) {
+        std::cerr << "Error: " << argv[1] << " does not fit in the ram" << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+
+    rom.begin = CPU::STARTING_ADDRESS;
+    rom.end = CPU::STARTING_ADDRESS + rom.bytes.size();
+
+    std::set<unsigned int> code = recoverCode(rom);
+
+    std::string path(argv[1]);
+    std::string name = path.substr(path.find_last_of("/\\") + 1);
+    for(char& c: name) {
+        // The name ends up in a string literal
+        if(c == '"' || c == '\\') {
+            c = '_';
+        }
+    }
+
+    std::string symbol = argc == 4 ? argv[3] : symbolFor(path);
+
+    std::ofstream out(argv[2]);
+    Emitter(rom, code, out).emit(name, symbol);
+
+    if(!out) {
+        std::cerr << "Error: cannot write " << argv[2] << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+
+    std::cout << name << ": " << code.size() << " instructions compiled into "
+              << symbol << std::endl;
+
+    return 0;
+}
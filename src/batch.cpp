@@ -0,0 +1,341 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cpu.hpp"
+#include "hash.hpp"
+#include "inputScript.hpp"
+#include "romCatalog.hpp"
+#include "romImage.hpp"
+#include "snapshotStore.hpp"
+#include "workStealingPool.hpp"
+
+/// chip8-batch: runs the jobs of a manifest on every core, each job on its
+/// own headless CPU, and prints the digests of the final framebuffer and
+/// ram of every job.
+///
+/// The manifest has one job per line, "rom inputScript frames [ipf [key]]",
+/// where inputScript is "-" for a run without input and ipf is the number
+/// of instructions per frame. With --snapshots, a job with a key starts
+/// from the state of that key in the snapshot store instead of from boot.
+/// Relative paths are relative to the manifest.
+///
+/// With --catalog, rom can also be "hash:" and the hash of a ROM of the
+/// catalog, which is then loaded from the catalog without touching the ROM
+/// file. A job without ipf takes the one the catalog has for its ROM, and
+/// every job of a ROM of the catalog runs with its quirks.
+///
+/// A job stops before its last frame once the ROM is halted, or waits for
+/// a key after the last event of its input script: the frames left would
+/// change neither the framebuffer nor the ram.
+
+static const unsigned int DEFAULT_INSTRUCTIONS_PER_FRAME = 11;
+
+static const std::string HASH_PREFIX = "hash:";
+
+struct Job {
+    std::string rom;
+    bool romFromCatalog;
+    uint64_t romHash;
+    std::string inputScript;
+    uint32_t frames;
+    // 0 when the manifest doesn't give it
+    unsigned int instructionsPerFrame;
+    bool fromSnapshot;
+    uint64_t snapshotKey;
+};
+
+struct Result {
+    bool succeeded = false;
+    std::string error;
+    uint64_t framebufferDigest = 0;
+    uint64_t ramDigest = 0;
+    unsigned int instructionsPerFrame = 0;
+    // Less than the frames of the job when it stopped idle
+    uint32_t frames = 0;
+};
+
+static std::string resolvePath(const std::string& directory, const std::string& path) {
+    if(path.empty() || path[0] == '/' || directory.empty()) {
+        return path;
+    }
+
+    return directory + "/" + path;
+}
+
+static std::vector<Job> loadManifest(const char* filename) {
+    std::ifstream file(filename);
+
+    if(!file.is_open()) {
+        throw std::runtime_error(std::string("Manifest doesn't exist: ") + filename);
+    }
+
+    std::string manifest(filename);
+    size_t slash = manifest.find_last_of('/');
+    std::string directory = slash == std::string::npos ? "" : manifest.substr(0, slash);
+
+    std::vector<Job> jobs;
+    std::string line;
+    unsigned int lineNumber = 0;
+
+    while(std::getline(file, line)) {
+        ++lineNumber;
+
+        std::istringstream stream(line);
+        Job job;
+
+        if(!(stream >> job.rom) || job.rom[0] == '#') {
+            continue;
+        }
+
+        if(!(stream >> job.inputScript >> job.frames)) {
+            throw std::runtime_error(std::string(filename) + ":" + std::to_string(lineNumber)
+                                     + ": expected \"rom inputScript frames [ipf]\"");
+        }
+
+        if(!(stream >> job.instructionsPerFrame)) {
+            job.instructionsPerFrame = 0;
+        }
+
+        std::string key;
+        job.fromSnapshot = static_cast<bool>(stream >> key);
+        job.snapshotKey = job.fromSnapshot ? std::stoull(key, nullptr, 0) : 0;
+
+        job.romFromCatalog = job.rom.compare(0, HASH_PREFIX.size(), HASH_PREFIX) == 0;
+        job.romHash = job.romFromCatalog
+                      ? std::stoull(job.rom.substr(HASH_PREFIX.size()), nullptr, 16) : 0;
+
+        if(!job.romFromCatalog) {
+            job.rom = resolvePath(directory, job.rom);
+        }
+        if(job.inputScript != "-") {
+            job.inputScript = resolvePath(directory, job.inputScript);
+        }
+
+        jobs.push_back(job);
+    }
+
+    return jobs;
+}
+
+#ifdef CHIP8_PROFILE
+// Counters of every job, dumped when all of them are done
+static Profile totalProfile;
+static std::mutex totalProfileMutex;
+#endif
+
+static Result runJob(const Job& job, CPU::Dispatch dispatch, const SnapshotStore* snapshots,
+                     const RomCatalog* catalog) {
+    Result result;
+
+    try {
+        InputScript inputScript;
+        if(job.inputScript != "-") {
+            inputScript = InputScript::load(job.inputScript.c_str());
+        }
+
+        std::unique_ptr<CPU> cpu(new CPU());
+        cpu->setDispatch(dispatch);
+
+        const RomCatalog::Entry* entry = nullptr;
+
+        if(job.romFromCatalog) {
+            entry = catalog ? catalog->find(job.romHash) : nullptr;
+
+            if(entry == nullptr) {
+                throw std::runtime_error("No ROM " + job.rom + " in the catalog");
+            }
+
+            cpu->loadROM(entry->rom, entry->size);
+        } else {
+            RomImage rom(job.rom.c_str());
+            entry = catalog ? catalog->find(rom.hash()) : nullptr;
+
+            cpu->loadROM(rom.data(), rom.size());
+        }
+
+        // The interpreters compiled for the quirks of the ROM
+        cpu->setQuirks(entry ? entry->info.quirks : Quirks::MODERN);
+
+        result.instructionsPerFrame = job.instructionsPerFrame;
+        if(result.instructionsPerFrame == 0) {
+            bool tuned = entry && entry->info.instructionsPerFrame;
+            result.instructionsPerFrame = tuned ? entry->info.instructionsPerFrame
+                                                : DEFAULT_INSTRUCTIONS_PER_FRAME;
+        }
+
+        if(inputScript.hasSeed()) {
+            cpu->seedRandom(inputScript.getSeed());
+        }
+
+        if(job.fromSnapshot) {
+            const CPUState* state = snapshots ? snapshots->find(job.snapshotKey) : nullptr;
+
+            if(state == nullptr) {
+                throw std::runtime_error("No snapshot " + std::to_string(job.snapshotKey));
+            }
+
+            cpu->loadState(*state);
+        }
+
+        for(uint32_t frame = 0; frame < job.frames; ++frame) {
+            inputScript.apply(frame, cpu->keyboard);
+            cpu->runFrame(result.instructionsPerFrame);
+            result.frames = frame + 1;
+
+            CPU::Idle idle = cpu->getIdle();
+            if(idle == CPU::Idle::Halted || (idle == CPU::Idle::Key && frame >= inputScript.lastFrame())) {
+                break;
+            }
+        }
+
+#ifdef CHIP8_PROFILE
+        {
+            std::lock_guard<std::mutex> lock(totalProfileMutex);
+            totalProfile.merge(cpu->profile);
+        }
+#endif
+
+        result.framebufferDigest = hashBytes(cpu->screen.bits, sizeof(cpu->screen.bits));
+        result.ramDigest = hashBytes(cpu->memory(), CPU::RAM_SIZE);
+        result.succeeded = true;
+    } catch(const std::exception& exception) {
+        result.error = exception.what();
+    }
+
+    return result;
+}
+
+static void usage(const char* program) {
+    std::cerr << "Usage: "
+              << program
+              << " PathToManifest [--threads N] [--dispatch table|switch|direct|threaded|predecoded]"
+              << " [--snapshots PathToStore] [--catalog PathToCatalog]"
+              << std::endl;
+    std::exit(EXIT_FAILURE);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        usage(argv[0]);
+    }
+
+    unsigned int numberThreads = std::thread::hardware_concurrency();
+    CPU::Dispatch dispatch = CPU::Dispatch::Direct;
+    const char* snapshotsFilename = nullptr;
+    const char* catalogFilename = nullptr;
+
+    for(int i = 2; i < argc; ++i) {
+        if(!strcmp(argv[i], "--threads") && i + 1 < argc) {
+            numberThreads = std::stoi(argv[++i]);
+        } else if(!strcmp(argv[i], "--dispatch") && i + 1 < argc) {
+            std::string name(argv[++i]);
+
+            if(name == "table") {
+                dispatch = CPU::Dispatch::Table;
+            } else if(name == "switch") {
+                dispatch = CPU::Dispatch::Switch;
+            } else if(name == "direct") {
+                dispatch = CPU::Dispatch::Direct;
+            } else if(name == "threaded") {
+                dispatch = CPU::Dispatch::Threaded;
+            } else if(name == "predecoded") {
+                dispatch = CPU::Dispatch::Predecoded;
+            } else {
+                usage(argv[0]);
+            }
+        } else if(!strcmp(argv[i], "--snapshots") && i + 1 < argc) {
+            snapshotsFilename = argv[++i];
+        } else if(!strcmp(argv[i], "--catalog") && i + 1 < argc) {
+            catalogFilename = argv[++i];
+        } else {
+            usage(argv[0]);
+        }
+    }
+
+    std::vector<Job> jobs;
+    std::unique_ptr<SnapshotStore> snapshots;
+    std::unique_ptr<RomCatalog> catalog;
+
+    try {
+        jobs = loadManifest(argv[1]);
+
+        if(snapshotsFilename) {
+            snapshots.reset(new SnapshotStore(snapshotsFilename, false));
+        }
+
+        if(catalogFilename) {
+            catalog.reset(new RomCatalog(catalogFilename, false));
+        }
+    } catch(const std::exception& exception) {
+        std::cerr << "Error: " << exception.what() << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+
+    std::vector<Result> results(jobs.size());
+    auto start = std::chrono::steady_clock::now();
+
+    {
+        WorkStealingPool pool(numberThreads);
+
+        for(size_t i = 0; i < jobs.size(); ++i) {
+            const SnapshotStore* store = snapshots.get();
+            const RomCatalog* roms = catalog.get();
+
+            pool.submit([&jobs, &results, dispatch, store, roms, i] {
+                results[i] = runJob(jobs[i], dispatch, store, roms);
+            });
+        }
+
+        pool.wait();
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    bool failed = false;
+    uint64_t instructions = 0;
+    size_t stoppedIdle = 0;
+
+    for(size_t i = 0; i < jobs.size(); ++i) {
+        if(results[i].succeeded) {
+            std::printf("%s\t%u\tframebuffer=%016llx\tram=%016llx\n", jobs[i].rom.c_str(),
+                        jobs[i].frames,
+                        static_cast<unsigned long long>(results[i].framebufferDigest),
+                        static_cast<unsigned long long>(results[i].ramDigest));
+
+            instructions += static_cast<uint64_t>(results[i].frames) * results[i].instructionsPerFrame;
+            stoppedIdle += results[i].frames < jobs[i].frames ? 1 : 0;
+        } else {
+            std::printf("%s\t%u\terror=%s\n", jobs[i].rom.c_str(), jobs[i].frames,
+                        results[i].error.c_str());
+            failed = true;
+        }
+    }
+
+    std::cerr << jobs.size() << " jobs on " << numberThreads << " threads in "
+              << seconds << " s, " << instructions / seconds / 1e6
+              << " million instructions per second, " << stoppedIdle << " stopped idle" << std::endl;
+
+#ifdef CHIP8_PROFILE
+    totalProfile.dump();
+#endif
+
+    return failed ? EXIT_FAILURE : 0;
+}
@@ -0,0 +1,303 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "compiledRom.hpp"
+#include "cpu.hpp"
+#include "cpuState.hpp"
+#include "presenter.hpp"
+
+/// chip8-bench: times the dispatch backends of the CPU on synthetic
+/// workloads and on the given ROMs, the heaviest opcode handlers on their
+/// own, idle loops skipped and interpreted, and the expansion of whole
+/// frames by each kernel of the Presenter. Every measure is repeated, and reports the median time per
+/// instruction, the fastest repetition and the median absolute deviation
+/// as a percentage of the median. A spread of more than a few percent
+/// means the machine was busy and the numbers should not be trusted.
+
+typedef std::chrono::steady_clock Clock;
+
+struct Workload {
+    const char* name;
+    std::vector<uint16_t> program;
+};
+
+struct Sample {
+    double median;
+    double min;
+    double spread;
+};
+
+struct Options {
+    unsigned int repetitions = 15;
+    double minimumTime = 0.02;
+};
+
+static const std::pair<const char*, CPU::Dispatch> DISPATCHES[] = {
+    { "table", CPU::Dispatch::Table },
+    { "switch", CPU::Dispatch::Switch },
+    { "direct", CPU::Dispatch::Direct },
+    { "threaded", CPU::Dispatch::Threaded },
+    { "predecoded", CPU::Dispatch::Predecoded },
+};
+
+static const std::pair<const char*, Presenter::Kernel> KERNELS[] = {
+    { "scalar", Presenter::Kernel::Scalar },
+    { "sse2", Presenter::Kernel::SSE2 },
+    { "avx2", Presenter::Kernel::AVX2 },
+};
+
+/// Endless loops, each stressing a different part of the CPU
+static const Workload WORKLOADS[] = {
+    { "alu", {
+        0x6005, 0x6103,                         // V0 = 5, V1 = 3
+        0x7001, 0x8014, 0x8105, 0x8012, 0x8203, // loop: arithmetic
+        0x3000, 0x8101, 0x4011, 0x6107,         // skips
+        0xA300, 0xF01E,                         // I = 0x300 + V0
+        0x1204,
+    } },
+    { "draw", {
+        0xA000,                                 // I = font
+        0xD01F, 0x7003, 0x7105, 0xD015,         // loop: draw and move
+        0x1202,
+    } },
+    { "memory", {
+        0xA400,                                 // I = 0x400
+        0xF033, 0xF265, 0x7301, 0xF355,         // loop: BCD, load, store
+        0xF365, 0x8034,
+        0x1202,
+    } },
+    { "scroll", {
+        0x00FF, 0xA000,                         // high resolution, I = font
+        0xD01F, 0x00C1, 0x00FB, 0x00D1, 0x00FC, // loop: draw, scroll around
+        0x1204,
+    } },
+    { "calls", {
+        0x2206, 0x7001, 0x1200,                 // loop: call, add
+        0x220A, 0x00EE,                         // nested call
+        0x6101, 0x00EE,
+    } },
+};
+
+/// Loops the CPU fast-forwards, see idleLoop.cpp
+static const Workload IDLE_WORKLOADS[] = {
+    { "wait key", {
+        0xF00A,                                 // V0 = key, none is pressed
+    } },
+    { "poll timer", {
+        0x6001, 0xF015,                         // DT = 1, never ticked
+        0xF007, 0x3000, 0x1204,                 // loop: until DT = 0
+        0x120A,
+    } },
+    { "halt", {
+        0x1200,                                 // jump to itself
+    } },
+};
+
+struct Handler {
+    const char* name;
+    uint16_t opcode;
+    uint16_t I;
+};
+
+/// Heavy handlers, and 6xkk as the cost of an instruction that does
+/// nearly nothing
+static const Handler HANDLERS[] = {
+    { "6xkk", 0x6012, 0x000 },
+    { "Dxyn (n = 15)", 0xD01F, 0x000 },
+    { "00E0", 0x00E0, 0x000 },
+    { "Fx33", 0xF033, 0x400 },
+    { "Fx55 (16 registers)", 0xFF55, 0x400 },
+    { "Fx65 (16 registers)", 0xFF65, 0x400 },
+};
+
+static void loadProgram(CPU& cpu, const std::vector<uint16_t>& program) {
+    CPUState state;
+    cpu.saveState(state);
+
+    for(size_t i = 0; i < program.size(); ++i) {
+        state.ram[CPU::STARTING_ADDRESS + 2 * i] = program[i] >> 8;
+        state.ram[CPU::STARTING_ADDRESS + 2 * i + 1] = program[i] & 0xFF;
+    }
+    state.pc = CPU::STARTING_ADDRESS;
+
+    cpu.loadState(state);
+}
+
+/// Time `run(count)`, which runs `count` instructions. The count grows
+/// until one repetition lasts long enough for the clock to be precise.
+template<typename Run>
+static Sample measure(Run run, const Options& options) {
+    auto seconds = [&run](unsigned int count) {
+        Clock::time_point start = Clock::now();
+        run(count);
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    };
+
+    unsigned int count = 1 << 12;
+    while(seconds(count) < options.minimumTime && count < (1u << 30)) {
+        count *= 2;
+    }
+
+    std::vector<double> samples;
+    for(unsigned int i = 0; i < options.repetitions; ++i) {
+        samples.push_back(seconds(count) * 1e9 / count);
+    }
+
+    std::sort(samples.begin(), samples.end());
+
+    Sample sample;
+    sample.median = samples[samples.size() / 2];
+    sample.min = samples.front();
+
+    std::vector<double> deviations;
+    for(double value: samples) {
+        deviations.push_back(std::fabs(value - sample.median));
+    }
+    std::sort(deviations.begin(), deviations.end());
+    sample.spread = 100.0 * deviations[deviations.size() / 2] / sample.median;
+
+    return sample;
+}
+
+static void printSample(const std::string& name, const char* variant, const Sample& sample) {
+    std::printf("%-24s %-12s %10.2f %10.2f %8.1f%%\n", name.c_str(), variant,
+                sample.median, sample.min, sample.spread);
+    std::fflush(stdout);
+}
+
+static void printHeader(const char* title, const char* variant = "dispatch",
+                        const char* unit = "ns/instr") {
+    std::printf("\n%-24s %-12s %10s %10s %9s\n", title, variant, unit, "min", "spread");
+}
+
+template<typename Load>
+static void benchDispatches(const std::string& name, Load load, const Options& options) {
+    for(const auto& dispatch: DISPATCHES) {
+        CPU cpu;
+        cpu.setDispatch(dispatch.second);
+        cpu.setIdleSkipping(false);
+        load(cpu);
+
+        printSample(name, dispatch.first,
+                    measure([&cpu](unsigned int count) { cpu.runCycles(count); }, options));
+    }
+}
+
+static void usage(const char* program) {
+    std::cerr << "Usage: " << program
+              << " [--repetitions N] [--time milliseconds] [PathToROM...]" << std::endl;
+    std::exit(EXIT_FAILURE);
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    std::vector<std::string> roms;
+
+    for(int i = 1; i < argc; ++i) {
+        if(!strcmp(argv[i], "--repetitions") && i + 1 < argc) {
+            options.repetitions = std::max(1, std::atoi(argv[++i]));
+        } else if(!strcmp(argv[i], "--time") && i + 1 < argc) {
+            options.minimumTime = std::max(1, std::atoi(argv[++i])) / 1000.0;
+        } else if(argv[i][0] == '-') {
+            usage(argv[0]);
+        } else {
+            roms.push_back(argv[i]);
+        }
+    }
+
+    try {
+        printHeader("workload");
+        for(const Workload& workload: WORKLOADS) {
+            benchDispatches(workload.name, [&workload](CPU& cpu) {
+                loadProgram(cpu, workload.program);
+            }, options);
+        }
+
+        for(const std::string& rom: roms) {
+            benchDispatches(rom, [&rom](CPU& cpu) { cpu.loadROM(rom.c_str()); }, options);
+        }
+
+        printHeader("idle");
+        for(const Workload& workload: IDLE_WORKLOADS) {
+            for(bool idleSkipping: { true, false }) {
+                CPU cpu;
+                cpu.setIdleSkipping(idleSkipping);
+                loadProgram(cpu, workload.program);
+
+                printSample(workload.name, idleSkipping ? "skipped" : "interpreted",
+                            measure([&cpu](unsigned int count) { cpu.runCycles(count); }, options));
+            }
+        }
+
+        // Decoding and resolving the handler are part of the measure,
+        // the same for every handler: compare against 6xkk
+        printHeader("handler", "execute");
+        for(const Handler& handler: HANDLERS) {
+            CPU cpu;
+            CompiledAccess::I(cpu) = handler.I;
+
+            printSample(handler.name, "execute", measure([&cpu, &handler](unsigned int count) {
+                for(unsigned int i = 0; i < count; ++i) {
+                    CompiledAccess::execute(cpu, handler.opcode);
+                }
+            }, options));
+        }
+
+        // Every row of a display with both planes in use, as after a clear
+        // or a switch of resolution
+        printHeader("present", "kernel", "ns/frame");
+        for(const auto& kernel: KERNELS) {
+            for(bool hires: { false, true }) {
+                for(unsigned int persistence: { 0u, 160u }) {
+                    Presenter presenter;
+                    if(!presenter.setKernel(kernel.second)) {
+                        continue;
+                    }
+                    presenter.setPersistence(persistence);
+
+                    Framebuffer framebuffer;
+                    framebuffer.setHires(hires);
+                    for(unsigned int plane = 0; plane < Framebuffer::PLANES; ++plane) {
+                        for(unsigned int word = 0; word < Framebuffer::WORDS; ++word) {
+                            for(unsigned int y = 0; y < Framebuffer::HIRES_HEIGHT; ++y) {
+                                framebuffer.bits[plane][word][y] = 0x9E3779B97F4A7C15ull * (y + 1) >> plane;
+                            }
+                        }
+                    }
+
+                    std::string name = std::string(hires ? "128x64" : "64x32")
+                        + (persistence ? " persistence" : "");
+                    printSample(name, kernel.first, measure([&presenter, &framebuffer](unsigned int count) {
+                        unsigned int begin;
+                        unsigned int end;
+
+                        for(unsigned int i = 0; i < count; ++i) {
+                            presenter.invalidate();
+                            presenter.present(framebuffer, begin, end);
+                        }
+                    }, options));
+                }
+            }
+        }
+    } catch(const std::exception& exception) {
+        std::cerr << exception.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return 0;
+}
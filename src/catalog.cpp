@@ -0,0 +1,104 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "quirks.hpp"
+#include "romCatalog.hpp"
+#include "romImage.hpp"
+
+/// chip8-catalog: adds ROMs and their info to a RomCatalog, and lists it.
+///
+/// "add" reads each ROM once; adding a ROM already in the catalog only
+/// replaces its info. chip8-batch --catalog and chip8 with CHIP8_CATALOG
+/// then find the ROM by the hash of its content.
+
+static void usage(const char* program) {
+    std::cerr << "Usage: " << program << " PathToCatalog list" << std::endl
+              << "       " << program << " PathToCatalog add PathToROM..."
+              << " [--title T] [--quirks modern|vip|schip|xochip] [--ipf N] [--keymap 16Keys]" << std::endl;
+    std::exit(EXIT_FAILURE);
+}
+
+static void list(const RomCatalog& catalog) {
+    for(size_t i = 0; i < catalog.size(); ++i) {
+        const RomCatalog::Entry& entry = catalog.entry(i);
+        const RomInfo& info = entry.info;
+
+        const char* quirks = quirksName(info.quirks);
+
+        std::printf("%016llx\t%u\tipf=%u\tquirks=%s\tkeymap=%.*s\t%.*s\n",
+                    static_cast<unsigned long long>(entry.hash), entry.size,
+                    info.instructionsPerFrame, quirks ? quirks : "?",
+                    static_cast<int>(RomInfo::KEYMAP_SIZE), info.keymap[0] ? info.keymap : "-",
+                    static_cast<int>(RomInfo::TITLE_SIZE), info.title);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if(argc < 3 || (strcmp(argv[2], "list") && strcmp(argv[2], "add"))) {
+        usage(argv[0]);
+    }
+
+    RomInfo info;
+    memset(&info, 0, sizeof(info));
+    std::vector<const char*> roms;
+    const char* quirks = nullptr;
+
+    for(int i = 3; i < argc; ++i) {
+        if(!strcmp(argv[i], "--title") && i + 1 < argc) {
+            strncpy(info.title, argv[++i], RomInfo::TITLE_SIZE - 1);
+        } else if(!strcmp(argv[i], "--quirks") && i + 1 < argc) {
+            quirks = argv[++i];
+        } else if(!strcmp(argv[i], "--ipf") && i + 1 < argc) {
+            info.instructionsPerFrame = std::strtoul(argv[++i], nullptr, 10);
+        } else if(!strcmp(argv[i], "--keymap") && i + 1 < argc) {
+            if(strlen(argv[++i]) != RomInfo::KEYMAP_SIZE) {
+                usage(argv[0]);
+            }
+            memcpy(info.keymap, argv[i], RomInfo::KEYMAP_SIZE);
+        } else if(argv[i][0] == '-') {
+            usage(argv[0]);
+        } else {
+            roms.push_back(argv[i]);
+        }
+    }
+
+    bool adding = !strcmp(argv[2], "add");
+
+    if(adding == roms.empty()) {
+        usage(argv[0]);
+    }
+
+    try {
+        info.quirks = quirks ? parseQuirks(quirks) : Quirks::MODERN;
+
+        RomCatalog catalog(argv[1], adding);
+
+        for(const char* filename : roms) {
+            RomImage rom(filename);
+            catalog.put(rom, info);
+        }
+
+        if(adding) {
+            catalog.flush();
+        } else {
+            list(catalog);
+        }
+    } catch(const std::exception& exception) {
+        std::cerr << exception.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return 0;
+}
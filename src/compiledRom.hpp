@@ -0,0 +1,105 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#ifndef compiledRom_hpp
+#define compiledRom_hpp
+
+#include <cstdint>
+
+#include "cpu.hpp"
+#include "hash.hpp"
+
+/// Native code emitted by chip8-aot for one ROM. Install it with
+/// CPU::setCompiledROM and Dispatch::Compiled.
+struct CompiledROM {
+    const char* name;
+
+    // Bytes of the ROM image the code was compiled from
+    uint16_t begin;
+    uint16_t end;
+
+    // One bit per byte of the ram, set for the bytes of the instructions
+    // that were compiled. Writes to the other bytes, e.g. the data of the
+    // ROM, leave the compiled code valid.
+    const uint8_t* code;
+
+    // hashCode of the ram the code was compiled from
+    uint64_t hash;
+
+    // Run at most `count` instructions from the pc. Returns how many are
+    // left when the pc reaches an address that was not compiled.
+    unsigned int (*run)(CPU& cpu, unsigned int count);
+
+    bool isCode(unsigned int address) const {
+        return (code[address >> 3] >> (address & 0x7)) & 0x1;
+    }
+
+    /// hashBytes of the bytes of `ram` marked in `code`, in address order
+    static uint64_t hashCode(const uint8_t* ram, const uint8_t* code) {
+        uint64_t hash = HASH_SEED;
+
+        for(unsigned int address = 0; address < CPU::RAM_SIZE; ++address) {
+            if((code[address >> 3] >> (address & 0x7)) & 0x1) {
+                hash = hashBytes(&ram[address], 1, hash);
+            }
+        }
+
+        return hash;
+    }
+};
+
+/// State of the CPU as seen by the compiled code
+struct CompiledAccess {
+    static const unsigned int STACK_SIZE = CPU::STACK_SIZE;
+
+    static uint8_t* registers(CPU& cpu) {
+        return cpu.registers;
+    }
+
+    static uint16_t* stack(CPU& cpu) {
+        return cpu.stack;
+    }
+
+    static uint16_t& I(CPU& cpu) {
+        return cpu.I;
+    }
+
+    static uint16_t& pc(CPU& cpu) {
+        return cpu.pc;
+    }
+
+    static uint8_t& sp(CPU& cpu) {
+        return cpu.sp;
+    }
+
+    static uint8_t& delayTimer(CPU& cpu) {
+        return cpu.delayTimer;
+    }
+
+    static uint8_t& soundTimer(CPU& cpu) {
+        return cpu.soundTimer;
+    }
+
+    // Still running compiled code, i.e. the ROM did not modify itself
+    static bool compiled(CPU& cpu) {
+        return cpu.compiledROM != nullptr;
+    }
+
+    // Interpret an instruction the compiled code does not inline
+    static void execute(CPU& cpu, uint16_t opcode) {
+        cpu.execute(opcode);
+    }
+
+    // Bookkeeping done after every instruction. Timers tick once per frame
+    // in CPU::runFrame, so this only feeds the profile and the trace.
+    static void retire(CPU& cpu, uint16_t address, uint16_t opcode) {
+        PROFILE_INSTRUCTION(cpu, address, opcode);
+        cpu.traceInstruction(address, opcode);
+    }
+};
+
+#endif /* compiledRom_hpp */
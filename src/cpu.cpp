@@ -5,33 +5,22 @@
 //  Copyright © 2020 Cosme Jordan. All rights reserved.
 //
 
-#include <iostream>
 #include <fstream>
 #include <iomanip>
-
-#include <SDL.h>
-#include <SDL_audio.h>
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
 
 #include "cpu.hpp"
-#include "sound.hpp"
-
-// #define DEBUGGING
-
-#ifdef DEBUGGING
-#define PRINT_DEBUG(a) std::cerr << a << std::endl;
-#else
-#define PRINT_DEBUG(a)
-#endif
+#include "compiledRom.hpp"
+#include "hash.hpp"
+#include "romImage.hpp"
 
-#define VIDEO_HEIGHT 32
-#define VIDEO_WIDTH 64
+static_assert(RomImage::MAX_SIZE == CPU::RAM_SIZE - CPU::STARTING_ADDRESS,
+              "A ROM image has to fit in ram");
 
-#include <chrono>
-#include <random>
-
-CPU::CPU(): randomEngine(std::chrono::system_clock::now().time_since_epoch().count()) {
-    distribution = std::uniform_int_distribution<uint8_t>(0, 255);
-    
+CPU::CPU(): randomCounter(DEFAULT_SEED) {
     // FIXME: TODO: Transfer that to file and then to the graphics itself
     const uint8_t GRAPHICS[] = {
         0xF0, 0x90, 0x90, 0x90, 0xF0,
@@ -51,6 +40,25 @@ CPU::CPU(): randomEngine(std::chrono::system_clock::now().time_since_epoch().cou
         0xF0, 0x80, 0xF0, 0x80, 0xF0,
         0xF0, 0x80, 0xF0, 0x80, 0x80
     };
+
+    const uint8_t LARGE_GRAPHICS[] = {
+        0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF,
+        0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF,
+        0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF,
+        0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF,
+        0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03,
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF,
+        0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18,
+        0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF,
+        0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3,
+        0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC,
+        0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C,
+        0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC,
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0
+    };
     
     pc = STARTING_ADDRESS;
     
@@ -58,9 +66,10 @@ CPU::CPU(): randomEngine(std::chrono::system_clock::now().time_since_epoch().cou
     memset(ram, INIT_VALUE, sizeof(ram));
     memset(stack, INIT_VALUE, sizeof(stack));
     memset(keyboard, INIT_VALUE, sizeof(keyboard));
-    memset(screen, INIT_VALUE, sizeof(screen));
+    memset(flags, INIT_VALUE, sizeof(flags));
     
     memcpy(&ram[STARTING_ADDRESS_FONTSET], GRAPHICS, NUMBER_FONTSETS);
+    memcpy(&ram[STARTING_ADDRESS_LARGE_FONTSET], LARGE_GRAPHICS, NUMBER_LARGE_FONTSETS);
 
     // table = new OpcodeFunction[SIZE_TABLE];
     // table0x0 = new OpcodeFunction[SIZE_TABLE0x0];
@@ -70,9 +79,7 @@ CPU::CPU(): randomEngine(std::chrono::system_clock::now().time_since_epoch().cou
 
     initNopes();
     initOpcodeTables();
-
-    SDL_Init(SDL_INIT_AUDIO);
-
+    installQuirks<ModernQuirks>();
 }
 
 CPU::~CPU() {
@@ -84,28 +91,186 @@ CPU::~CPU() {
 }
 
 void CPU::loadROM(const char* filename) {
-    std::ifstream rom(filename, std::ios::binary | std::ios::ate);
-
-    if(rom.is_open()) {
-        // FIXME: TODO: TODO Refactor
-        std::streampos tempSize = rom.tellg();
-        
-        char* temp = new char[tempSize];
-        rom.seekg(0, std::ios::beg);
-        rom.read(temp, tempSize);
-        rom.close();
-        
-        memcpy(&ram[STARTING_ADDRESS], temp, tempSize*sizeof(char));
-        
-        delete[] temp;
+    RomImage rom(filename);
+
+    loadROM(rom.data(), rom.size());
+}
+
+void CPU::loadROM(const uint8_t* rom, size_t size) {
+    if(size > RAM_SIZE - STARTING_ADDRESS) {
+        throw std::runtime_error("ROM of " + std::to_string(size) + " bytes doesn't fit in ram");
+    }
+
+    memcpy(&ram[STARTING_ADDRESS], rom, size);
+    invalidateCache(STARTING_ADDRESS, RAM_SIZE - 1);
+}
+
+void CPU::setSoundSink(SoundSink* soundSink) {
+    this->soundSink = soundSink;
+}
+
+void CPU::setDisplaySink(DisplaySink* displaySink) {
+    this->displaySink = displaySink;
+}
+
+void CPU::present() {
+    if(displaySink) {
+        displaySink->draw(screen);
+    }
+}
+
+void CPU::setTrace(TraceRing* trace) {
+    this->trace = trace;
+}
+
+void CPU::setFrameRing(FrameRing* frameRing) {
+    this->frameRing = frameRing;
+}
+
+void CPU::setDispatch(Dispatch dispatch) {
+    this->dispatch = dispatch;
+
+    if(dispatch == Dispatch::Predecoded) {
+        if(!decodedCache) {
+            // Value-initialized, so every entry starts invalid
+            decodedCache.reset(new DecodedInstruction[RAM_SIZE]());
+        }
     } else {
-        throw std::runtime_error("ROM Doesn't Exist !");
+        decodedCache.reset();
+    }
+}
+
+void CPU::setQuirks(uint32_t quirks) {
+    switch(quirks) {
+        case Quirks::MODERN:
+            installQuirks<ModernQuirks>();
+            break;
+        case Quirks::COSMAC_VIP:
+            installQuirks<CosmacVipQuirks>();
+            break;
+        case Quirks::SUPER_CHIP:
+            installQuirks<SuperChipQuirks>();
+            break;
+        case Quirks::XO_CHIP:
+            installQuirks<XoChipQuirks>();
+            break;
+        default:
+            throw std::runtime_error("No interpreter for the quirks " + std::to_string(quirks));
+    }
+
+    // Decoded instructions point to the handlers of the old quirks. The
+    // compiled ROM only inlines what no quirk changes.
+    const CompiledROM* previousROM = compiledROM;
+    invalidateCache(0, RAM_SIZE - 1);
+    setCompiledROM(previousROM);
+}
+
+uint32_t CPU::getQuirks() const {
+    return quirks;
+}
+
+void CPU::seedRandom(uint64_t seed) {
+    randomCounter = seed;
+}
+
+/// SplitMix64: the counter advances by a constant and is mixed into the
+/// output, so the whole state of the generator is one integer
+uint8_t CPU::nextRandom() {
+    uint64_t z = (randomCounter += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+
+    return static_cast<uint8_t>((z ^ (z >> 31)) >> 56);
+}
+
+const uint8_t* CPU::memory() const {
+    return ram;
+}
+
+static_assert(sizeof(CPUState::ram) == CPU::RAM_SIZE, "CPUState does not match the ram");
+static_assert(sizeof(CPUState::screen) == sizeof(Framebuffer::bits), "CPUState does not match the screen");
+
+void CPU::saveState(CPUState& state) const {
+    static_assert(sizeof(state.flags) == sizeof(flags), "CPUState does not match the flags");
+
+    memset(&state, 0, sizeof(state));
+
+    state.magic = CPUState::MAGIC;
+    state.version = CPUState::VERSION;
+    state.size = sizeof(CPUState);
+
+    memcpy(state.screen, screen.bits, sizeof(state.screen));
+    state.hires = screen.isHires() ? 1 : 0;
+    state.planes = screen.selectedPlanes();
+    state.pc = pc;
+    state.I = I;
+    memcpy(state.stack, stack, sizeof(state.stack));
+    memcpy(state.registers, registers, sizeof(state.registers));
+    state.sp = sp;
+    state.delayTimer = delayTimer;
+    state.soundTimer = soundTimer;
+    state.randomCounter = randomCounter;
+    memcpy(state.keyboard, keyboard, sizeof(state.keyboard));
+    memcpy(state.flags, flags, sizeof(state.flags));
+    memcpy(state.ram, ram, sizeof(state.ram));
+}
+
+/// States come from files and mappings, so they are checked before anything
+/// is loaded: a stack pointer past the stack or unknown planes are
+/// rejected, the addresses are masked to the ram
+void CPU::loadState(const CPUState& state) {
+    if(state.magic != CPUState::MAGIC || state.version != CPUState::VERSION
+       || state.size != sizeof(CPUState)) {
+        throw std::runtime_error("Incompatible save state !");
+    }
+
+    if(state.sp > STACK_SIZE || state.planes > 0x3) {
+        throw std::runtime_error("Corrupted save state !");
     }
+
+    screen.load(&state.screen[0][0][0], state.hires != 0, state.planes);
+    pc = state.pc & (RAM_SIZE - 1);
+    I = state.I & (RAM_SIZE - 1);
+    memcpy(stack, state.stack, sizeof(stack));
+    memcpy(registers, state.registers, sizeof(registers));
+    sp = state.sp;
+    delayTimer = state.delayTimer;
+    soundTimer = state.soundTimer;
+    randomCounter = state.randomCounter;
+    memcpy(keyboard, state.keyboard, sizeof(keyboard));
+    memcpy(flags, state.flags, sizeof(flags));
+    memcpy(ram, state.ram, sizeof(ram));
+
+    // The compiled ROM is kept if the ram still holds its code
+    const CompiledROM* previousROM = compiledROM;
+    invalidateCache(0, RAM_SIZE - 1);
+    setCompiledROM(previousROM);
+}
+
+/// Only accepted when the ram holds the instructions the ROM was compiled
+/// from, so it has to be called after loadROM. Its data may differ, e.g.
+/// in a state saved after the ROM wrote to it.
+bool CPU::setCompiledROM(const CompiledROM* compiledROM) {
+    this->compiledROM = nullptr;
+
+    if(compiledROM == nullptr || compiledROM->end > RAM_SIZE
+       || compiledROM->begin > compiledROM->end) {
+        return false;
+    }
+
+    if(CompiledROM::hashCode(ram, compiledROM->code) != compiledROM->hash) {
+        return false;
+    }
+
+    this->compiledROM = compiledROM;
+
+    return true;
 }
 
 void CPU::initNopes() {
     std::fill_n(table, SIZE_TABLE, &CPU::opcodeNOPE);
     std::fill_n(table0x0, SIZE_TABLE0x0, &CPU::opcodeNOPE);
+    std::fill_n(table0x5, SIZE_TABLE0x5, &CPU::opcodeNOPE);
 
     /// Strange bug: 0xE+0x1: Invalid suffix '+0x1' on integer constant,
     /// but with 0xF+0x1, it works...
@@ -120,43 +285,73 @@ void CPU::initOpcodeTables() {
     table[0x2] = &CPU::opcode2nnn;
     table[0x3] = &CPU::opcode3xkk;
     table[0x4] = &CPU::opcode4xkk;
-    table[0x5] = &CPU::opcode5xy0;
+    table[0x5] = &CPU::accessTable0x5;
     table[0x6] = &CPU::opcode6xkk;
     table[0x7] = &CPU::opcode7xkk;
     table[0x8] = &CPU::accessTable0x8;
     table[0x9] = &CPU::opcode9xy0;
     table[0xA] = &CPU::opcodeAnnn;
-    table[0xB] = &CPU::opcodeBnnn;
     table[0xC] = &CPU::opcodeCxkk;
-    table[0xD] = &CPU::opcodeDxyn;
     table[0xE] = &CPU::accessTable0xE;
     table[0xF] = &CPU::accessTable0xF;
     
-    table0x0[0x0] = &CPU::opcode00E0;
-    table0x0[0xE] = &CPU::opcode00EE;
+    table0x0[0xE0] = &CPU::opcode00E0;
+    table0x0[0xEE] = &CPU::opcode00EE;
+    std::fill_n(&table0x0[0xC0], 0x10, &CPU::opcode00Cn);
+    std::fill_n(&table0x0[0xD0], 0x10, &CPU::opcode00Dn);
+    table0x0[0xFB] = &CPU::opcode00FB;
+    table0x0[0xFC] = &CPU::opcode00FC;
+    table0x0[0xFD] = &CPU::opcode00FD;
+    table0x0[0xFE] = &CPU::opcode00FE;
+    table0x0[0xFF] = &CPU::opcode00FF;
+
+    table0x5[0x0] = &CPU::opcode5xy0;
+    table0x5[0x2] = &CPU::opcode5xy2;
+    table0x5[0x3] = &CPU::opcode5xy3;
     
     table0x8[0x0] = &CPU::opcode8xy0;
-    table0x8[0x1] = &CPU::opcode8xy1;
-    table0x8[0x2] = &CPU::opcode8xy2;
-    table0x8[0x3] = &CPU::opcode8xy3;
     table0x8[0x4] = &CPU::opcode8xy4;
     table0x8[0x5] = &CPU::opcode8xy5;
-    table0x8[0x6] = &CPU::opcode8xy6;
     table0x8[0x7] = &CPU::opcode8xy7;
-    table0x8[0xE] = &CPU::opcode8xyE;
     
     table0xE[0x1] = &CPU::opcodeExA1;
     table0xE[0xE] = &CPU::opcodeEx9E;
     
+    table0xF[0x01] = &CPU::opcodeFn01;
     table0xF[0x07] = &CPU::opcodeFx07;
     table0xF[0x0A] = &CPU::opcodeFx0A;
     table0xF[0x15] = &CPU::opcodeFx15;
     table0xF[0x18] = &CPU::opcodeFx18;
     table0xF[0x1E] = &CPU::opcodeFx1E;
     table0xF[0x29] = &CPU::opcodeFx29;
+    table0xF[0x30] = &CPU::opcodeFx30;
     table0xF[0x33] = &CPU::opcodeFx33;
-    table0xF[0x55] = &CPU::opcodeFx55;
-    table0xF[0x65] = &CPU::opcodeFx65;
+    table0xF[0x75] = &CPU::opcodeFx75;
+    table0xF[0x85] = &CPU::opcodeFx85;
+}
+
+/// The handlers that depend on the quirks, compiled for the policy Q
+template<class Q>
+void CPU::installQuirks() {
+    quirks = Q::BITS;
+
+    table[0xB] = &CPU::opcodeBnnn<Q>;
+    table[0xD] = &CPU::opcodeDxyn<Q>;
+
+    table0x8[0x1] = &CPU::opcode8xy1<Q>;
+    table0x8[0x2] = &CPU::opcode8xy2<Q>;
+    table0x8[0x3] = &CPU::opcode8xy3<Q>;
+    table0x8[0x6] = &CPU::opcode8xy6<Q>;
+    table0x8[0xE] = &CPU::opcode8xyE<Q>;
+
+    table0xF[0x55] = &CPU::opcodeFx55<Q>;
+    table0xF[0x65] = &CPU::opcodeFx65<Q>;
+
+    switchInstruction = &CPU::executeInstruction<Q>;
+    directLoops[0] = &CPU::runDirect<false, Q>;
+    directLoops[1] = &CPU::runDirect<true, Q>;
+    threadedLoops[0] = &CPU::runThreaded<false, Q>;
+    threadedLoops[1] = &CPU::runThreaded<true, Q>;
 }
 
 // =============================================================================
@@ -165,7 +360,11 @@ void CPU::initOpcodeTables() {
 // Functions for accessing the different tables
 
 void CPU::accessTable0x0() {
-    (this->*table0x0[get0xFValue()])();
+    (this->*table0x0[get0xFFValue()])();
+}
+
+void CPU::accessTable0x5() {
+    (this->*table0x5[get0xFValue()])();
 }
 
 void CPU::accessTable0x8() {
@@ -181,6 +380,78 @@ void CPU::accessTable0xF() {
     (this->*table0xF[v])();
 }
 
+// =============================================================================
+// =============================================================================
+// =============================================================================
+// Decoding Functions
+
+uint16_t CPU::fetch(uint16_t address) {
+    return (ram[address & (RAM_SIZE - 1)] << 8u)
+         | ram[(address + 1) & (RAM_SIZE - 1)];
+}
+
+/// Walk the tables once, so that a decoded instruction calls its opcode
+/// function directly instead of going through accessTable0x*
+CPU::OpcodeFunction CPU::resolve(uint16_t opcode) {
+    switch((opcode & 0xF000u) >> 12u) {
+        case 0x0:
+            return table0x0[opcode & 0x00FFu];
+        case 0x5:
+            return table0x5[opcode & 0x000Fu];
+        case 0x8:
+            return table0x8[opcode & 0x000Fu];
+        case 0xE:
+            return table0xE[opcode & 0x000Fu];
+        case 0xF:
+            return table0xF[opcode & 0x00FFu];
+        default:
+            return table[(opcode & 0xF000u) >> 12u];
+    }
+}
+
+void CPU::decodeOperands(uint16_t opcode, DecodedInstruction& decodedInstruction) {
+    decodedInstruction.opcode = opcode;
+    decodedInstruction.nnn = opcode & 0x0FFFu;
+    decodedInstruction.x = (opcode >> 8) & 0xFu;
+    decodedInstruction.y = (opcode >> 4) & 0xFu;
+    decodedInstruction.kk = opcode & 0x00FFu;
+    decodedInstruction.n = opcode & 0x000Fu;
+}
+
+void CPU::decode(uint16_t address, DecodedInstruction& decodedInstruction) {
+    uint16_t opcode = fetch(address);
+
+    decodeOperands(opcode, decodedInstruction);
+    decodedInstruction.function = resolve(opcode);
+    decodedInstruction.valid = true;
+}
+
+/// Called whenever the bytes [begin, end] of the ram are written
+void CPU::invalidateCache(unsigned int begin, unsigned int end) {
+    unsigned int last = std::min(end, RAM_SIZE - 1);
+
+    if(decodedCache) {
+        // The instruction starting one byte before begin overlaps the write
+        unsigned int first = begin > 0 ? begin - 1 : 0;
+
+        for(unsigned int address = first; address <= last; ++address) {
+            decodedCache[address].valid = false;
+        }
+    }
+
+    // Self-modified code: interpret the rest of the run
+    if(compiledROM && begin < compiledROM->end && last >= compiledROM->begin) {
+        unsigned int end = std::min<unsigned int>(last, compiledROM->end - 1);
+
+        for(unsigned int address = std::max<unsigned int>(begin, compiledROM->begin); address <= end; ++address) {
+            if(compiledROM->isCode(address)) {
+                compiledROM = nullptr;
+                break;
+            }
+        }
+    }
+}
+
 // =============================================================================
 // =============================================================================
 // =============================================================================
@@ -195,23 +466,23 @@ size_t CPU::get0xFFValue() {
 }
 
 uint8_t CPU::x() {
-    return (opcode >> 8) & 0xFu;
+    return instruction->x;
 }
 
 uint8_t CPU::y() {
-    return (opcode >> 4) & 0xFu;
+    return instruction->y;
 }
 
 uint8_t CPU::kk() {
-    return opcode & 0x00FFu;
+    return instruction->kk;
 }
 
 uint8_t CPU::n() {
-    return opcode & 0x000Fu;
+    return instruction->n;
 }
 
 uint16_t CPU::nnn() {
-    return opcode & 0x0FFFu;
+    return instruction->nnn;
 }
 
 // =============================================================================
@@ -220,111 +491,153 @@ uint16_t CPU::nnn() {
 // Opcodes Functions
 
 void CPU::opcodeNOPE() {
-    PRINT_DEBUG("opcode NOPE");
 }
 
 void CPU::opcode0nnn() {
-    PRINT_DEBUG("opcode 0nnn");
-    
     // This opcode is only used on old computers
 }
 
 void CPU::opcode00E0() {
-    PRINT_DEBUG("opcode 00E0");
-    
-    std::fill_n(screen, 64 * 32, 0);
+    screen.clear();
 }
 
 void CPU::opcode00EE() {
-    PRINT_DEBUG("opcode 00EE");
-    
+    // A return with an empty stack stays on this instruction, like 00FD
+    if(sp == 0) {
+        pc -= 2;
+        return;
+    }
+
     pc = stack[--sp];
 }
 
+void CPU::opcode00Cn() {
+    screen.scrollDown(n());
+}
+
+void CPU::opcode00Dn() {
+    screen.scrollUp(n());
+}
+
+void CPU::opcode00FB() {
+    screen.scrollRight();
+}
+
+void CPU::opcode00FC() {
+    screen.scrollLeft();
+}
+
+void CPU::opcode00FD() {
+    // Exit the interpreter: the CPU stays on this instruction
+    pc -= 2;
+}
+
+void CPU::opcode00FE() {
+    screen.setHires(false);
+}
+
+void CPU::opcode00FF() {
+    screen.setHires(true);
+}
+
 void CPU::opcode1nnn() {
-    PRINT_DEBUG("opcode 1nnn");
-    
     pc = nnn();
 }
 
 void CPU::opcode2nnn() {
-    PRINT_DEBUG("opcode 2nnn");
-    
+    // Same for a call with a full stack
+    if(sp == STACK_SIZE) {
+        pc -= 2;
+        return;
+    }
+
     stack[sp++] = pc;
     pc = nnn();
 }
 
 void CPU::opcode3xkk() {
-    PRINT_DEBUG("opcode 3xkk");
-    
     if (registers[x()] == kk()) {
         pc += 2;
     }
 }
 
 void CPU::opcode4xkk() {
-    PRINT_DEBUG("opcode 4xkk");
-    
     if (registers[x()] != kk()) {
         pc += 2;
     }
 }
 
 void CPU::opcode5xy0() {
-    PRINT_DEBUG("opcode 5xy0");
-    
     if (registers[x()] == registers[y()]) {
         pc += 2;
     }
 }
 
+void CPU::opcode5xy2() {
+    uint8_t Vx = x();
+    uint8_t Vy = y();
+    int step = Vx <= Vy ? 1 : -1;
+
+    // Registers are stored from Vx to Vy, in reverse order when Vx > Vy
+    for(int i = 0; i <= std::abs(Vy - Vx); ++i) {
+        ram[(I + i) & (RAM_SIZE - 1)] = registers[Vx + step * i];
+    }
+    invalidateWrapped(I, std::abs(Vy - Vx) + 1);
+}
+
+void CPU::opcode5xy3() {
+    uint8_t Vx = x();
+    uint8_t Vy = y();
+    int step = Vx <= Vy ? 1 : -1;
+
+    for(int i = 0; i <= std::abs(Vy - Vx); ++i) {
+        registers[Vx + step * i] = ram[(I + i) & (RAM_SIZE - 1)];
+    }
+}
+
 void CPU::opcode6xkk() {
-    PRINT_DEBUG("opcode 6xkk");
-    
     registers[x()] = kk();
 }
 
 void CPU::opcode7xkk() {
-    PRINT_DEBUG("opcode 7xkk");
-    
     registers[x()] += kk();
 }
 
 void CPU::opcode8xy0() {
-    PRINT_DEBUG("opcode 8xy0");
-    
     registers[x()] = registers[y()];
 }
 
+template<class Q>
 void CPU::opcode8xy1() {
-    PRINT_DEBUG("opcode 8xy1");
-    
     registers[x()] |= registers[y()];
+    if(Q::RESET_VF) {
+        registers[0xF] = 0;
+    }
 }
 
+template<class Q>
 void CPU::opcode8xy2() {
-    PRINT_DEBUG("opcode 8xy2");
-    
     registers[x()] &= registers[y()];
+    if(Q::RESET_VF) {
+        registers[0xF] = 0;
+    }
 }
 
+template<class Q>
 void CPU::opcode8xy3() {
-    PRINT_DEBUG("opcode 8xy3");
-    
     registers[x()] ^= registers[y()];
+    if(Q::RESET_VF) {
+        registers[0xF] = 0;
+    }
 }
 
 void CPU::opcode8xy4() {
-    PRINT_DEBUG("opcode 8xy4");
-    
     uint16_t sum = registers[x()] + registers[y()];
     registers[0xF] = sum > 0x0FFu ? 1 : 0;
     registers[x()] = sum & 0x00FFu;
 }
 
 void CPU::opcode8xy5() {
-    PRINT_DEBUG("opcode 8xy5");
-    
     uint8_t Vx = x();
     uint8_t Vy = y();
     
@@ -332,111 +645,80 @@ void CPU::opcode8xy5() {
     registers[Vx] -= registers[Vy];
 }
 
+template<class Q>
 void CPU::opcode8xy6() {
-    PRINT_DEBUG("opcode 8xy6");
-    
-    registers[0xF] = registers[x()] & 0x1;
+    uint8_t Vs = Q::SHIFT_VY ? y() : x();
+
+    registers[0xF] = registers[Vs] & 0x1;
     
     // Division by 2
-    registers[x()] >>= 1;
+    registers[x()] = registers[Vs] >> 1;
 }
 
 void CPU::opcode8xy7() {
-    PRINT_DEBUG("opcode 8xy7");
-    
     uint8_t Vx = x();
     uint8_t Vy = y();
     
     registers[0xF] = registers[Vy] > registers[Vx] ? 1 : 0;
-    registers[Vx] = Vy - Vx;
+    registers[Vx] = registers[Vy] - registers[Vx];
 }
 
+template<class Q>
 void CPU::opcode8xyE() {
-    PRINT_DEBUG("opcode 8xyE");
-    
     uint8_t Vx = x();
+    uint8_t Vs = Q::SHIFT_VY ? y() : Vx;
     
-    registers[0xF] = (registers[Vx] & 0x80) >> 7;
-    registers[Vx] <<= 1;
+    registers[0xF] = (registers[Vs] & 0x80) >> 7;
+    registers[Vx] = registers[Vs] << 1;
 }
 
 void CPU::opcode9xy0() {
-    PRINT_DEBUG("opcode 9xy0");
-    
     if(registers[x()] != registers[y()]) {
         pc += 2;
     }
 }
 
 void CPU::opcodeAnnn() {
-    PRINT_DEBUG("opcode Annn");
-    
     I = nnn();
 }
 
+template<class Q>
 void CPU::opcodeBnnn() {
-    PRINT_DEBUG("opcode Bnnn");
-    
-    pc = registers[0] + nnn();
+    pc = registers[Q::JUMP_VX ? x() : 0] + nnn();
 }
 
 void CPU::opcodeCxkk() {
-    PRINT_DEBUG("opcode Cxkk");
-    
-    registers[x()] = distribution(randomEngine) & (opcode & kk());
+    registers[x()] = nextRandom() & kk();
 }
 
+template<class Q>
 void CPU::opcodeDxyn() {
-    PRINT_DEBUG("opcode Dxyn");
-
-    uint8_t xP = registers[x()] % VIDEO_WIDTH;
-    uint8_t yP = registers[y()] % VIDEO_HEIGHT;
-    
-    registers[0xF] = 0;
-    
-    for(int i = 0; i < n(); ++i) {
-        uint8_t sprite = ram[I + i];
-        
-        for(int j = 0; j < 8; ++j) {
-            uint8_t pixel = sprite & (0x80 >> j);
-            uint32_t* pixelPtr = &screen[(yP + i) * VIDEO_WIDTH + (xP + j)];
-            
-            if (pixel) {
-                if (*pixelPtr == SCREEN_PIXEL_CONSTANT) {
-                    registers[0xF] = 1;
-                }
-                
-                *pixelPtr ^= SCREEN_PIXEL_CONSTANT;
-            }
-        }
-    }
+    registers[0xF] = drawSprite<Q::WRAP_SPRITES>(registers[x()], registers[y()], n());
 }
 
+/// Only the low nibble of Vx names a key
 void CPU::opcodeEx9E() {
-    PRINT_DEBUG("opcode Ex9E");
-    
-    if(keyboard[registers[x()]]) {
+    if(keyboard[registers[x()] & 0xF]) {
         pc += 2;
     }
 }
 
 void CPU::opcodeExA1() {
-    PRINT_DEBUG("opcode ExA1");
-    
-    if(!keyboard[registers[x()]]) {
+    if(!keyboard[registers[x()] & 0xF]) {
         pc += 2;
     }
 }
 
+void CPU::opcodeFn01() {
+    // Not a register: n selects the planes
+    screen.selectPlanes(x());
+}
+
 void CPU::opcodeFx07() {
-    PRINT_DEBUG("opcode Fx07");
-    
     registers[x()] = delayTimer;
 }
 
 void CPU::opcodeFx0A() {
-    PRINT_DEBUG("opcode Fx0A");
-    
     for(int i = 0; i < 16; ++i) {
         if (keyboard[i]) {
             registers[x()] = i;
@@ -449,87 +731,157 @@ void CPU::opcodeFx0A() {
 }
 
 void CPU::opcodeFx15() {
-    PRINT_DEBUG("opcode Fx015");
-    
     delayTimer = registers[x()];
 }
 
 void CPU::opcodeFx18() {
-    PRINT_DEBUG("opcode Fx018");
-    
     soundTimer = registers[x()];
 }
 
 void CPU::opcodeFx1E() {
-    PRINT_DEBUG("opcode Fx1DE");
-    
     I += registers[x()];
 }
 
 void CPU::opcodeFx29() {
-    PRINT_DEBUG("opcode Fx29");
-    
     I = STARTING_ADDRESS_FONTSET + (5*registers[x()]);
 }
 
+void CPU::opcodeFx30() {
+    I = STARTING_ADDRESS_LARGE_FONTSET + (10 * (registers[x()] & 0xF));
+}
+
 void CPU::opcodeFx33() {
-    PRINT_DEBUG("opcode Fx33");
-    
-    uint8_t contentVx = registers[x()];
-    
-    ram[I] = (contentVx / 100) % 10;
-    ram[I + 1] = (contentVx / 10) % 10;
-    ram[I + 2] = contentVx % 10;
+    storeDigits(registers[x()]);
 }
 
+template<class Q>
 void CPU::opcodeFx55() {
-    PRINT_DEBUG("opcode Fx55");
-    
-    memcpy(&ram[I], registers, (x()+1)*sizeof(uint8_t));
+    storeRegisters(x());
+    if(Q::INCREMENT_I) {
+        I += x() + 1;
+    }
 }
 
+template<class Q>
 void CPU::opcodeFx65() {
-    PRINT_DEBUG("opcode Fx65");
-    
-    memcpy(registers, &ram[I], (x()+1)*sizeof(uint8_t));
+    loadRegisters(x());
+    if(Q::INCREMENT_I) {
+        I += x() + 1;
+    }
 }
 
-void CPU::printErrorOnOpcode() {
-    std::cerr << "Undefined opcode: " << std::hex << opcode << std::endl;
-    throw std::runtime_error("");
+void CPU::opcodeFx75() {
+    memcpy(flags, registers, (x()+1)*sizeof(uint8_t));
 }
 
-void CPU::executeOpcode00EStar() {
-    PRINT_DEBUG("opcode 00EStar");
-    switch(opcode & 0x000F) {
-        case 0x0000:
+void CPU::opcodeFx85() {
+    memcpy(registers, flags, (x()+1)*sizeof(uint8_t));
+}
+
+/// Dxyn at (vx, vy), wrapped to the display. n = 0 draws a 16x16 sprite.
+/// Returns the new value of VF.
+template<bool WRAP>
+uint8_t CPU::drawSprite(uint8_t vx, uint8_t vy, unsigned int n) {
+    unsigned int planes = screen.selectedPlanes();
+    unsigned int size = (n == 0 ? 32 : n) * ((planes & 0x1) + (planes >> 1));
+    const uint8_t* sprite = &ram[I];
+
+    // A sprite read past the end of the ram wraps to its beginning
+    uint8_t wrapped[64];
+    if(I + size > RAM_SIZE) {
+        for(unsigned int i = 0; i < size; ++i) {
+            wrapped[i] = ram[(I + i) & (RAM_SIZE - 1)];
+        }
+        sprite = wrapped;
+    }
+
+    // Both resolutions are powers of 2
+    unsigned int xP = vx & (screen.width() - 1);
+    unsigned int yP = vy & (screen.height() - 1);
+
+    bool collision = n == 0 ? screen.drawLargeSprite<WRAP>(xP, yP, sprite)
+                            : screen.drawSprite<WRAP>(xP, yP, sprite, n);
+
+    return collision ? 1 : 0;
+}
+
+// The direct handlers draw through them as well
+template uint8_t CPU::drawSprite<false>(uint8_t vx, uint8_t vy, unsigned int n);
+template uint8_t CPU::drawSprite<true>(uint8_t vx, uint8_t vy, unsigned int n);
+
+void CPU::executeOpcode00StarStar() {
+    switch(opcode & 0x00F0) {
+        case 0x00C0:
+            opcode00Cn();
+            return;
+        case 0x00D0:
+            opcode00Dn();
+            return;
+    }
+
+    switch(opcode & 0x00FF) {
+        case 0x00E0:
             opcode00E0();
             break;
-        case 0x000E:
+        case 0x00EE:
             opcode00EE();
             break;
+        case 0x00FB:
+            opcode00FB();
+            break;
+        case 0x00FC:
+            opcode00FC();
+            break;
+        case 0x00FD:
+            opcode00FD();
+            break;
+        case 0x00FE:
+            opcode00FE();
+            break;
+        case 0x00FF:
+            opcode00FF();
+            break;
         default:
-            printErrorOnOpcode();
+            opcodeNOPE();
     }
 }
 
+void CPU::executeOpcode5XYStar() {
+    switch(opcode & 0x000F) {
+        case 0x0000:
+            opcode5xy0();
+            break;
+        case 0x0002:
+            opcode5xy2();
+            break;
+        case 0x0003:
+            opcode5xy3();
+            break;
+        default:
+            opcodeNOPE();
+    }
+}
+
+/// Decoded on the low nibble, like table0xE: Exy1 is ExA1, ExyE is Ex9E
 void CPU::executeOpcodeEXStarStar() {
-    PRINT_DEBUG("opcode 00EXStarStar");
-    switch(opcode & 0x00FF) {
-        case 0x009E:
+    switch(opcode & 0x000F) {
+        case 0x000E:
             opcodeEx9E();
             break;
-        case 0x00A1:
+        case 0x0001:
             opcodeExA1();
             break;
         default:
-            printErrorOnOpcode();
+            opcodeNOPE();
     }
 }
 
+template<class Q>
 void CPU::opcodeFXStarStar() {
-    PRINT_DEBUG("opcode FXStarStar");
     switch(opcode & 0x00FF) {
+        case 0x0001:
+            opcodeFn01();
+            break;
         case 0x0007:
             opcodeFx07();
             break;
@@ -548,34 +900,43 @@ void CPU::opcodeFXStarStar() {
         case 0x0029:
             opcodeFx29();
             break;
+        case 0x0030:
+            opcodeFx30();
+            break;
         case 0x0033:
             opcodeFx33();
             break;
         case 0x0055:
-            opcodeFx55();
+            opcodeFx55<Q>();
             break;
         case 0x0065:
-            opcodeFx65();
+            opcodeFx65<Q>();
+            break;
+        case 0x0075:
+            opcodeFx75();
+            break;
+        case 0x0085:
+            opcodeFx85();
             break;
         default:
-            printErrorOnOpcode();
+            opcodeNOPE();
     }
 }
 
+template<class Q>
 void CPU::executeOpcode0x8StarStarStar() {
-    PRINT_DEBUG("opcode 0x8StarStarStar");
     switch(opcode & 0x000F) {
         case 0x0000:
             opcode8xy0();
             break;
         case 0x0001:
-            opcode8xy1();
+            opcode8xy1<Q>();
             break;
         case 0x0002:
-            opcode8xy2();
+            opcode8xy2<Q>();
             break;
         case 0x0003:
-            opcode8xy3();
+            opcode8xy3<Q>();
             break;
         case 0x0004:
             opcode8xy4();
@@ -584,27 +945,27 @@ void CPU::executeOpcode0x8StarStarStar() {
             opcode8xy5();
             break;
         case 0x0006:
-            opcode8xy6();
+            opcode8xy6<Q>();
             break;
         case 0x0007:
             opcode8xy7();
             break;
         case 0x000E:
-            opcode8xyE();
+            opcode8xyE<Q>();
             break;
         default:
-            printErrorOnOpcode();
+            opcodeNOPE();
     }
 }
 
-// TODO: Maybe use a function for chosing between
-/// one or the other (executeInstruction or opcodeTable)
+/// Dispatch::Switch, the alternative to the opcode tables. Unknown opcodes
+/// are ignored.
+template<class Q>
 void CPU::executeInstruction() {
-    PRINT_DEBUG("Execute Instruction");
     switch(opcode & 0xF000) {
         case 0x0000:
-            // Opcode: 00E*
-            executeOpcode00EStar();
+            // Opcode: 00**
+            executeOpcode00StarStar();
             break;
         case 0x1000:
             opcode1nnn();
@@ -619,7 +980,8 @@ void CPU::executeInstruction() {
             opcode4xkk();
             break;
         case 0x5000:
-            opcode5xy0();
+            // Opcode: 5XY*
+            executeOpcode5XYStar();
             break;
         case 0x6000:
             opcode6xkk();
@@ -629,7 +991,7 @@ void CPU::executeInstruction() {
             break;
         case 0x8000:
             // 0x8***
-            executeOpcode0x8StarStarStar();
+            executeOpcode0x8StarStarStar<Q>();
             break;
         case 0x9000:
             opcode9xy0();
@@ -638,13 +1000,13 @@ void CPU::executeInstruction() {
             opcodeAnnn();
             break;
         case 0xB000:
-            opcodeBnnn();
+            opcodeBnnn<Q>();
             break;
         case 0xC000:
             opcodeCxkk();
             break;
         case 0xD000:
-            opcodeDxyn();
+            opcodeDxyn<Q>();
             break;
         case 0xE000:
             // Opcode: EX**
@@ -652,26 +1014,124 @@ void CPU::executeInstruction() {
             break;
         case 0xF000:
             // Opcode FX**
-            opcodeFXStarStar();
+            opcodeFXStarStar<Q>();
             break;
         default:
-            printErrorOnOpcode();
+            opcodeNOPE();
+    }
+}
+
+// =============================================================================
+// =============================================================================
+// =============================================================================
+// Compiled Code Functions
+
+void CPU::runCompiled(unsigned int count) {
+    while(count > 0) {
+        if(compiledROM) {
+            count = compiledROM->run(*this, count);
+
+            if(count == 0) {
+                return;
+            }
+        }
+
+        // The pc is outside of the compiled code, e.g. after Bnnn
+        step();
+        --count;
+    }
+}
+
+/// Run a single instruction on behalf of the compiled code
+void CPU::execute(uint16_t opcode) {
+    this->opcode = opcode;
+    decodeOperands(opcode, decoded);
+    instruction = &decoded;
+
+    (this->*resolve(opcode))();
+}
+
+/// Run one frame of 1/60 s: a batch of `instructionsPerFrame` instructions,
+/// then a single tick of the 60 Hz timers. The speed of a ROM then only
+/// depends on `instructionsPerFrame`, not on how often the host calls this.
+void CPU::runFrame(unsigned int instructionsPerFrame) {
+    runCycles(instructionsPerFrame);
+    tickTimers();
+
+    if(frameRing) {
+        frameRing->publish(screen);
     }
 }
 
 void CPU::runCycle() {
-    PRINT_DEBUG("Run Cycle");
-    opcode = (ram[pc] << 8u) | ram[pc + 1];
-    pc += 2;
-
-    // executeInstruction();
-    PRINT_DEBUG("Execute Instruction");
-    (this->*table[(opcode & 0x0F000u) >> 12u])();
-    PRINT_DEBUG("Finished executing Instruction");
-    
+    runCycles(1);
+}
+
+/// Run `count` instructions, without ticking the timers. With
+/// Dispatch::Compiled, this is where whole compiled blocks run back to
+/// back.
+void CPU::runCycles(unsigned int count) {
+    // A trace wants every instruction, idle or not
+    if(trace) {
+        idle = Idle::None;
+    } else {
+        count = skipIdle(count);
+    }
+
+    if(dispatch == Dispatch::Compiled) {
+        runCompiled(count);
+    } else if(dispatch == Dispatch::Direct) {
+        (this->*directLoops[trace ? 1 : 0])(count);
+    } else if(dispatch == Dispatch::Threaded) {
+        (this->*threadedLoops[trace ? 1 : 0])(count);
+    } else {
+        for(unsigned int i = 0; i < count; ++i) {
+            step();
+        }
+    }
+}
+
+void CPU::step() {
+    uint16_t address = pc;
+
+    if(dispatch == Dispatch::Predecoded) {
+        DecodedInstruction& entry = decodedCache[pc & (RAM_SIZE - 1)];
+
+        if(!entry.valid) {
+            decode(pc, entry);
+        }
+
+        instruction = &entry;
+        opcode = entry.opcode;
+        PROFILE_INSTRUCTION(*this, pc, opcode);
+        pc += 2;
+
+        (this->*entry.function)();
+    } else {
+        opcode = fetch(pc);
+        PROFILE_INSTRUCTION(*this, pc, opcode);
+        pc += 2;
+
+        decodeOperands(opcode, decoded);
+        instruction = &decoded;
+
+        if(dispatch == Dispatch::Switch) {
+            (this->*switchInstruction)();
+        } else {
+            (this->*table[(opcode & 0x0F000u) >> 12u])();
+        }
+    }
+
+    traceInstruction(address, opcode);
+}
+
+/// Called at 60 Hz, once per frame
+void CPU::tickTimers() {
+    PROFILE_TIMER_TICK(*this);
+
     if(soundTimer > 0) {
-        if(soundTimer == 1) {
-            simpleSound.play(FREQUENCY, SOUND_DURATION);
+        if(soundTimer == 1 && soundSink) {
+            soundSink->play(FREQUENCY, SOUND_DURATION);
         }
 
         --soundTimer;
@@ -13,37 +13,55 @@
 #include <fstream>
 
 #include <chrono>
-#include <random>
+#include <memory>
 
-#include "sound.hpp"
+#include "cpuState.hpp"
+#include "framebuffer.hpp"
+#include "frameRing.hpp"
+#include "profile.hpp"
+#include "quirks.hpp"
+#include "sinks.hpp"
+#include "traceRing.hpp"
 
 #define INIT_VALUE 0
 
+struct CompiledROM;
+struct CompiledAccess;
+struct DirectDispatch;
+
 class CPU {
+public:
+    static const unsigned int STARTING_ADDRESS = 0x200;
+    static const unsigned int RAM_SIZE = 0x1000; // 4096
+
 private:
     // Constants
     static const unsigned int NUMBER_FONTSETS = 80;
-    static const unsigned int STARTING_ADDRESS = 0x200;
     static const unsigned int STARTING_ADDRESS_FONTSET = 0x50;
-    static const uint32_t SCREEN_PIXEL_CONSTANT = 0xFFFFFFFF;
+
+    // 10-byte digits of the SUPER-CHIP, right after the small ones
+    static const unsigned int NUMBER_LARGE_FONTSETS = 160;
+    static const unsigned int STARTING_ADDRESS_LARGE_FONTSET = 0xA0;
     
     static const unsigned int SIZE_TABLE = 0x10;
-    static const unsigned int SIZE_TABLE0x0 = 0xF;
-    static const unsigned int SIZE_TABLE0x8 = 0xF;
-    static const unsigned int SIZE_TABLE0xE = 0xF;
+    static const unsigned int SIZE_TABLE0x0 = 0x100;
+    static const unsigned int SIZE_TABLE0x5 = 0x10;
+    static const unsigned int SIZE_TABLE0x8 = 0x10;
+    static const unsigned int SIZE_TABLE0xE = 0x10;
     static const unsigned int SIZE_TABLE0xF = 0x100;
     
-    static const unsigned int RAM_SIZE = 0x1000; // 4096
     static const unsigned int STACK_SIZE = 0x10; // 16
     static const unsigned int REGISTERS_SIZE = 0x10; // 16
     static const unsigned int KEYBOARD_SIZE = 0x10; // 16
-    
-    static const unsigned int SCREEN_SIZE = 64 * 32;
+    static const unsigned int FLAGS_SIZE = 0x10; // 16
     
 private:
     uint8_t registers[REGISTERS_SIZE];
     uint8_t ram[RAM_SIZE];
     uint16_t stack[STACK_SIZE];
+
+    // User flags of the SUPER-CHIP, see Fx75 and Fx85
+    uint8_t flags[FLAGS_SIZE];
     
     uint16_t opcode = INIT_VALUE;
     uint16_t I = INIT_VALUE;
@@ -63,70 +81,303 @@ private:
     
     OpcodeFunction table[SIZE_TABLE];
     OpcodeFunction table0x0[SIZE_TABLE0x0];
+    OpcodeFunction table0x5[SIZE_TABLE0x5];
     OpcodeFunction table0x8[SIZE_TABLE0x8];
     OpcodeFunction table0xE[SIZE_TABLE0xE];
     OpcodeFunction table0xF[SIZE_TABLE0xF];
 
+    /// An instruction with its handler resolved through the tables and its
+    /// operands already extracted from the opcode
+    struct DecodedInstruction {
+        OpcodeFunction function;
+        uint16_t opcode;
+        uint16_t nnn;
+        uint8_t x;
+        uint8_t y;
+        uint8_t kk;
+        uint8_t n;
+        bool valid;
+    };
+
+    // Operands of the instruction being executed
+    DecodedInstruction decoded;
+    const DecodedInstruction* instruction = &decoded;
+
+    // One entry per address of the ram, only allocated for
+    // Dispatch::Predecoded
+    std::unique_ptr<DecodedInstruction[]> decodedCache;
+
+    static constexpr unsigned int MAX_IDLE_LOOP = 8;
+
+    // After a probe that found no idle loop, the next ones are skipped for
+    // a number of runCycles that doubles up to this
+    static constexpr unsigned int MAX_IDLE_BACKOFF = 16;
+    unsigned int idleBackoff = 0;
+    unsigned int idleCountdown = 0;
+
+    /// Registers of the CPU an idle loop can change
+    struct IdleProbe {
+        uint8_t registers[REGISTERS_SIZE];
+        uint16_t stack[STACK_SIZE];
+        uint16_t I;
+        uint16_t pc;
+        uint8_t sp;
+
+        bool operator==(const IdleProbe& other) const;
+    };
+
+    typedef void (CPU::*RunFunction)(unsigned int count);
+
+    // Interpreters specialized for the quirks, see setQuirks. The loops
+    // are indexed by whether a trace is set.
+    uint32_t quirks = Quirks::MODERN;
+    OpcodeFunction switchInstruction;
+    RunFunction directLoops[2];
+    RunFunction threadedLoops[2];
 
     static const int SOUND_DURATION = 50;
     static constexpr double FREQUENCY = 440;
 
-    SimpleSound simpleSound;
+    // Optional record of the executed instructions
+    TraceRing* trace = nullptr;
+
+    // Optional export of the frames to other processes
+    FrameRing* frameRing = nullptr;
+
+    SoundSink* soundSink = nullptr;
+    DisplaySink* displaySink = nullptr;
     
 public:
     uint8_t keyboard[KEYBOARD_SIZE];
-    uint32_t screen[SCREEN_SIZE];
+    Framebuffer screen;
+
+#ifdef CHIP8_PROFILE
+    // Execution counters, see profile.hpp
+    Profile profile;
+#endif
     
+public:
+    enum class Dispatch {
+        // Fetch and decode every instruction through the opcode tables
+        Table,
+        // Same, through the switch of executeInstruction
+        Switch,
+        // Jump straight from the whole opcode to a handler specialized for
+        // its x and y, see directDispatch.cpp
+        Direct,
+        // Same handlers, threaded with computed gotos
+        Threaded,
+        // Decode an instruction once and reuse it until its bytes change
+        Predecoded,
+        // Run the code emitted by chip8-aot, interpret what it does not cover
+        Compiled
+    };
+
+    /// What a ROM spins on, see idleLoop.cpp
+    enum class Idle {
+        // Running, or not checked because a trace is set or a probe just failed
+        None,
+        // Until the delay timer changes
+        Timer,
+        // Until a key changes, e.g. Fx0A
+        Key,
+        // Forever, e.g. a jump to itself or 00FD
+        Halted
+    };
+
+private:
+    Dispatch dispatch = Dispatch::Table;
+
+    bool idleSkipping = true;
+    Idle idle = Idle::None;
+
+    friend struct CompiledAccess;
+    friend struct DirectDispatch;
+    const CompiledROM* compiledROM = nullptr;
+
 public:
     CPU();
     ~CPU();
     void loadROM(const char* filename);
+
+    /// Copy a ROM already in memory, e.g. a RomImage or an entry of a
+    /// RomCatalog. Throws std::runtime_error when it doesn't fit in ram.
+    void loadROM(const uint8_t* rom, size_t size);
+    void runFrame(unsigned int instructionsPerFrame);
     void runCycle();
+    void runCycles(unsigned int count);
+    void tickTimers();
+    
+    // Sinks are optional, a CPU without them runs headless
+    void setSoundSink(SoundSink* soundSink);
+    void setDisplaySink(DisplaySink* displaySink);
+    void present();
+
+    // Optional as well, the CPU records every instruction it runs in it
+    void setTrace(TraceRing* trace);
+
+    // Optional as well, the CPU publishes the display in it at the end of
+    // every runFrame
+    void setFrameRing(FrameRing* frameRing);
+
+    void setDispatch(Dispatch dispatch);
+
+    /// Pick the interpreters compiled for a quirk profile, e.g. the one of
+    /// the ROM in a RomCatalog. Throws std::runtime_error when `quirks` is
+    /// not one of the profiles of quirks.hpp.
+    void setQuirks(uint32_t quirks);
+    uint32_t getQuirks() const;
+
+    // A CPU starts from DEFAULT_SEED, so runs are reproducible unless the
+    // caller seeds it
+    static const uint64_t DEFAULT_SEED = 0x43484950382D3031ull;
+    void seedRandom(uint64_t seed);
+
+    const uint8_t* memory() const;
+
+    void saveState(CPUState& state) const;
+    void loadState(const CPUState& state);
+
+    bool setCompiledROM(const CompiledROM* compiledROM);
+
+    /// What the CPU was found spinning on at the start of the last
+    /// runCycles. Idle loops are fast-forwarded unless disabled, e.g. to
+    /// benchmark the dispatch.
+    Idle getIdle() const;
+    void setIdleSkipping(bool idleSkipping);
     
 private:
     
-    void randomGenerator();
-    std::default_random_engine randomEngine;
-    std::uniform_int_distribution<uint8_t> distribution;
+    // Counter of the random generator of Cxkk, see nextRandom
+    uint64_t randomCounter;
+    uint8_t nextRandom();
     
     void initNopes();
     void initOpcodeTables();
+    template<class Q> void installQuirks();
+
+    uint16_t fetch(uint16_t address);
+    OpcodeFunction resolve(uint16_t opcode);
+    void decodeOperands(uint16_t opcode, DecodedInstruction& decodedInstruction);
+    void decode(uint16_t address, DecodedInstruction& decodedInstruction);
+    void invalidateCache(unsigned int begin, unsigned int end);
+
+    void runCompiled(unsigned int count);
+    // TRACED is whether a trace is set: the loops without one do not pay
+    // for its check on every instruction
+    template<bool TRACED, class Q> void runDirect(unsigned int count);
+    template<bool TRACED, class Q> void runThreaded(unsigned int count);
+
+    void execute(uint16_t opcode);
+
+    unsigned int probeIdle(IdleProbe& probe, bool& readsTimer, bool& readsKeys) const;
+    unsigned int skipIdle(unsigned int count);
+
+    void step();
+
+    template<bool WRAP> uint8_t drawSprite(uint8_t vx, uint8_t vy, unsigned int n);
+
+    /// Fx55 and Fx65, V0 to Vx. Past the end of the ram the addresses wrap,
+    /// like those of the sprites.
+    void storeRegisters(unsigned int x) {
+        if(I + x < RAM_SIZE) {
+            memcpy(&ram[I], registers, x + 1);
+            invalidateCache(I, I + x);
+        } else {
+            for(unsigned int i = 0; i <= x; ++i) {
+                ram[(I + i) & (RAM_SIZE - 1)] = registers[i];
+            }
+            invalidateWrapped(I, x + 1);
+        }
+    }
+
+    /// invalidateCache of `count` bytes from `address`, wrapping at the end
+    /// of the ram like the stores to them
+    void invalidateWrapped(unsigned int address, unsigned int count) {
+        unsigned int first = address & (RAM_SIZE - 1);
+        unsigned int last = first + count - 1;
+
+        if(last < RAM_SIZE) {
+            invalidateCache(first, last);
+        } else {
+            invalidateCache(first, RAM_SIZE - 1);
+            invalidateCache(0, last & (RAM_SIZE - 1));
+        }
+    }
+
+    /// Fx33, the digits of Vx from I, wrapping at the end of the ram
+    void storeDigits(uint8_t value) {
+        ram[I & (RAM_SIZE - 1)] = (value / 100) % 10;
+        ram[(I + 1) & (RAM_SIZE - 1)] = (value / 10) % 10;
+        ram[(I + 2) & (RAM_SIZE - 1)] = value % 10;
+        invalidateWrapped(I, 3);
+    }
+
+    void loadRegisters(unsigned int x) {
+        if(I + x < RAM_SIZE) {
+            memcpy(registers, &ram[I], x + 1);
+        } else {
+            for(unsigned int i = 0; i <= x; ++i) {
+                registers[i] = ram[(I + i) & (RAM_SIZE - 1)];
+            }
+        }
+    }
+
+    void traceInstruction(uint16_t address, uint16_t opcode) {
+        if(trace) {
+            uint8_t x = (opcode >> 8) & 0xF;
+            trace->record(address, opcode, I, x, registers[x]);
+        }
+    }
     
     void opcode0nnn();
     void opcode00E0();
     void opcode00EE();
+    void opcode00Cn();
+    void opcode00Dn();
+    void opcode00FB();
+    void opcode00FC();
+    void opcode00FD();
+    void opcode00FE();
+    void opcode00FF();
     void opcode1nnn();
     void opcode2nnn();
     void opcode3xkk();
     void opcode4xkk();
     void opcode5xy0();
+    void opcode5xy2();
+    void opcode5xy3();
     void opcode6xkk();
     void opcode7xkk();
     void opcode8xy0();
-    void opcode8xy1();
-    void opcode8xy2();
-    void opcode8xy3();
+    template<class Q> void opcode8xy1();
+    template<class Q> void opcode8xy2();
+    template<class Q> void opcode8xy3();
     void opcode8xy4();
     void opcode8xy5();
-    void opcode8xy6();
+    template<class Q> void opcode8xy6();
     void opcode8xy7();
-    void opcode8xyE();
+    template<class Q> void opcode8xyE();
     void opcode9xy0();
     void opcodeAnnn();
-    void opcodeBnnn();
+    template<class Q> void opcodeBnnn();
     void opcodeCxkk();
-    void opcodeDxyn();
+    template<class Q> void opcodeDxyn();
     void opcodeEx9E();
     void opcodeExA1();
+    void opcodeFn01();
     void opcodeFx07();
     void opcodeFx0A();
     void opcodeFx15();
     void opcodeFx18();
     void opcodeFx1E();
     void opcodeFx29();
+    void opcodeFx30();
     void opcodeFx33();
-    void opcodeFx55();
-    void opcodeFx65();
+    template<class Q> void opcodeFx55();
+    template<class Q> void opcodeFx65();
+    void opcodeFx75();
+    void opcodeFx85();
     
     // Utility functions
     uint8_t y();
@@ -143,6 +394,7 @@ private:
     // =========================================================================
     
     void accessTable0x0();
+    void accessTable0x5();
     void accessTable0x8();
     void accessTable0xE();
     void accessTable0xF();
@@ -152,14 +404,14 @@ private:
     // =========================================================================
     // =========================================================================
     
-    void executeOpcode00EStar();
+    void executeOpcode00StarStar();
+    void executeOpcode5XYStar();
     void executeOpcodeEXStarStar();
-    void executeOpcode0x8StarStarStar();
-    void opcodeFXStarStar();
+    template<class Q> void executeOpcode0x8StarStarStar();
+    template<class Q> void opcodeFXStarStar();
     
-    void executeInstruction();
+    template<class Q> void executeInstruction();
     
-    void printErrorOnOpcode();
 };
 
 #endif /* cpu_hpp */
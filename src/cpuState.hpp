@@ -0,0 +1,53 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#ifndef cpuState_hpp
+#define cpuState_hpp
+
+#include <cstdint>
+#include <type_traits>
+
+/// Save state of a CPU. It is a plain struct with a fixed layout, so it is
+/// written, read and copied with a single memcpy. Fields are stored in the
+/// byte order of the host.
+///
+/// Bump VERSION whenever the layout changes.
+struct CPUState {
+    static const uint32_t MAGIC = 0x53533843; // "C8SS"
+    static const uint16_t VERSION = 3;
+
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved0;
+    uint32_t size;
+    uint32_t reserved1;
+
+    uint64_t randomCounter;
+    // Planes, words and rows of the Framebuffer
+    uint64_t screen[2][2][64];
+
+    uint16_t pc;
+    uint16_t I;
+    uint16_t stack[16];
+    uint8_t registers[16];
+    uint8_t sp;
+    uint8_t delayTimer;
+    uint8_t soundTimer;
+    uint8_t reserved2;
+    uint8_t keyboard[16];
+    uint8_t flags[16];
+    uint8_t hires;
+    uint8_t planes;
+    uint8_t reserved3[6];
+
+    uint8_t ram[4096];
+};
+
+static_assert(std::is_trivially_copyable<CPUState>::value, "CPUState must be copyable with memcpy");
+static_assert(sizeof(CPUState) == 6264, "The layout of CPUState changed, bump its VERSION");
+
+#endif /* cpuState_hpp */
@@ -0,0 +1,581 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#include <array>
+#include <cstring>
+#include <utility>
+
+#include "cpu.hpp"
+#include "opcodeFamily.hpp"
+#include "profile.hpp"
+
+static inline uint16_t fetchOpcode(const uint8_t* ram, uint16_t address) {
+    return (ram[address & (CPU::RAM_SIZE - 1)] << 8u)
+         | ram[(address + 1) & (CPU::RAM_SIZE - 1)];
+}
+
+// =============================================================================
+// =============================================================================
+// =============================================================================
+// Handlers with x and y baked in, for Dispatch::Direct
+
+typedef void (*DirectHandler)(CPU& cpu, uint16_t opcode);
+
+struct DirectDispatch {
+    static void nope(CPU&, uint16_t) {
+    }
+
+    static void cls(CPU& cpu, uint16_t) {
+        cpu.screen.clear();
+    }
+
+    // Both halt on an empty or full stack, see CPU::opcode00EE
+    static void ret(CPU& cpu, uint16_t) {
+        if(cpu.sp == 0) {
+            cpu.pc -= 2;
+            return;
+        }
+
+        cpu.pc = cpu.stack[--cpu.sp];
+    }
+
+    static void jp(CPU& cpu, uint16_t opcode) {
+        cpu.pc = opcode & 0x0FFFu;
+    }
+
+    static void call(CPU& cpu, uint16_t opcode) {
+        if(cpu.sp == CPU::STACK_SIZE) {
+            cpu.pc -= 2;
+            return;
+        }
+
+        cpu.stack[cpu.sp++] = cpu.pc;
+        cpu.pc = opcode & 0x0FFFu;
+    }
+
+    static void ldI(CPU& cpu, uint16_t opcode) {
+        cpu.I = opcode & 0x0FFFu;
+    }
+
+    template<class Q>
+    static void jpV0(CPU& cpu, uint16_t opcode) {
+        cpu.pc = cpu.registers[Q::JUMP_VX ? (opcode >> 8) & 0xF : 0] + (opcode & 0x0FFFu);
+    }
+
+    static void scd(CPU& cpu, uint16_t opcode) {
+        cpu.screen.scrollDown(opcode & 0x000Fu);
+    }
+
+    static void scu(CPU& cpu, uint16_t opcode) {
+        cpu.screen.scrollUp(opcode & 0x000Fu);
+    }
+
+    static void scr(CPU& cpu, uint16_t) {
+        cpu.screen.scrollRight();
+    }
+
+    static void scl(CPU& cpu, uint16_t) {
+        cpu.screen.scrollLeft();
+    }
+
+    static void halt(CPU& cpu, uint16_t) {
+        cpu.pc -= 2;
+    }
+
+    static void low(CPU& cpu, uint16_t) {
+        cpu.screen.setHires(false);
+    }
+
+    static void high(CPU& cpu, uint16_t) {
+        cpu.screen.setHires(true);
+    }
+
+    template<unsigned int X>
+    static void seKK(CPU& cpu, uint16_t opcode) {
+        if(cpu.registers[X] == (opcode & 0x00FFu)) {
+            cpu.pc += 2;
+        }
+    }
+
+    template<unsigned int X>
+    static void sneKK(CPU& cpu, uint16_t opcode) {
+        if(cpu.registers[X] != (opcode & 0x00FFu)) {
+            cpu.pc += 2;
+        }
+    }
+
+    template<unsigned int X, unsigned int Y>
+    static void seXY(CPU& cpu, uint16_t) {
+        if(cpu.registers[X] == cpu.registers[Y]) {
+            cpu.pc += 2;
+        }
+    }
+
+    template<unsigned int X>
+    static void ldKK(CPU& cpu, uint16_t opcode) {
+        cpu.registers[X] = opcode & 0x00FFu;
+    }
+
+    template<unsigned int X>
+    static void addKK(CPU& cpu, uint16_t opcode) {
+        cpu.registers[X] += opcode & 0x00FFu;
+    }
+
+    template<unsigned int X, unsigned int Y>
+    static void ldXY(CPU& cpu, uint16_t) {
+        cpu.registers[X] = cpu.registers[Y];
+    }
+
+    template<unsigned int X, unsigned int Y, class Q>
+    static void orXY(CPU& cpu, uint16_t) {
+        cpu.registers[X] |= cpu.registers[Y];
+        if(Q::RESET_VF) {
+            cpu.registers[0xF] = 0;
+        }
+    }
+
+    template<unsigned int X, unsigned int Y, class Q>
+    static void andXY(CPU& cpu, uint16_t) {
+        cpu.registers[X] &= cpu.registers[Y];
+        if(Q::RESET_VF) {
+            cpu.registers[0xF] = 0;
+        }
+    }
+
+    template<unsigned int X, unsigned int Y, class Q>
+    static void xorXY(CPU& cpu, uint16_t) {
+        cpu.registers[X] ^= cpu.registers[Y];
+        if(Q::RESET_VF) {
+            cpu.registers[0xF] = 0;
+        }
+    }
+
+    // The flag is written before the result, like the interpreter, so VF
+    // as an operand behaves the same
+    template<unsigned int X, unsigned int Y>
+    static void addXY(CPU& cpu, uint16_t) {
+        uint16_t sum = cpu.registers[X] + cpu.registers[Y];
+        cpu.registers[0xF] = sum > 0x0FFu ? 1 : 0;
+        cpu.registers[X] = sum & 0x00FFu;
+    }
+
+    template<unsigned int X, unsigned int Y>
+    static void sub(CPU& cpu, uint16_t) {
+        cpu.registers[0xF] = cpu.registers[X] > cpu.registers[Y] ? 1 : 0;
+        cpu.registers[X] -= cpu.registers[Y];
+    }
+
+    template<unsigned int X, unsigned int Y, class Q>
+    static void shr(CPU& cpu, uint16_t) {
+        constexpr unsigned int S = Q::SHIFT_VY ? Y : X;
+
+        cpu.registers[0xF] = cpu.registers[S] & 0x1;
+        cpu.registers[X] = cpu.registers[S] >> 1;
+    }
+
+    template<unsigned int X, unsigned int Y>
+    static void subn(CPU& cpu, uint16_t) {
+        cpu.registers[0xF] = cpu.registers[Y] > cpu.registers[X] ? 1 : 0;
+        cpu.registers[X] = cpu.registers[Y] - cpu.registers[X];
+    }
+
+    template<unsigned int X, unsigned int Y, class Q>
+    static void shl(CPU& cpu, uint16_t) {
+        constexpr unsigned int S = Q::SHIFT_VY ? Y : X;
+
+        cpu.registers[0xF] = (cpu.registers[S] & 0x80) >> 7;
+        cpu.registers[X] = cpu.registers[S] << 1;
+    }
+
+    // Vx to Vy, in reverse order when X > Y
+    template<unsigned int X, unsigned int Y>
+    static void saveXY(CPU& cpu, uint16_t) {
+        constexpr unsigned int COUNT = (X <= Y ? Y - X : X - Y) + 1;
+
+        for(unsigned int i = 0; i < COUNT; ++i) {
+            cpu.ram[(cpu.I + i) & (CPU::RAM_SIZE - 1)] = cpu.registers[X <= Y ? X + i : X - i];
+        }
+        cpu.invalidateWrapped(cpu.I, COUNT);
+    }
+
+    template<unsigned int X, unsigned int Y>
+    static void loadXY(CPU& cpu, uint16_t) {
+        constexpr unsigned int COUNT = (X <= Y ? Y - X : X - Y) + 1;
+
+        for(unsigned int i = 0; i < COUNT; ++i) {
+            cpu.registers[X <= Y ? X + i : X - i] = cpu.ram[(cpu.I + i) & (CPU::RAM_SIZE - 1)];
+        }
+    }
+
+    template<unsigned int X, unsigned int Y>
+    static void sneXY(CPU& cpu, uint16_t) {
+        if(cpu.registers[X] != cpu.registers[Y]) {
+            cpu.pc += 2;
+        }
+    }
+
+    template<unsigned int X>
+    static void rnd(CPU& cpu, uint16_t opcode) {
+        cpu.registers[X] = cpu.nextRandom() & (opcode & 0x00FFu);
+    }
+
+    template<unsigned int X, unsigned int Y, class Q>
+    static void drw(CPU& cpu, uint16_t opcode) {
+        cpu.registers[0xF] = cpu.drawSprite<Q::WRAP_SPRITES>(cpu.registers[X], cpu.registers[Y],
+                                                             opcode & 0x000Fu);
+    }
+
+    template<unsigned int X>
+    static void skp(CPU& cpu, uint16_t) {
+        if(cpu.keyboard[cpu.registers[X] & 0xF]) {
+            cpu.pc += 2;
+        }
+    }
+
+    template<unsigned int X>
+    static void sknp(CPU& cpu, uint16_t) {
+        if(!cpu.keyboard[cpu.registers[X] & 0xF]) {
+            cpu.pc += 2;
+        }
+    }
+
+    template<unsigned int X>
+    static void ldVxDT(CPU& cpu, uint16_t) {
+        cpu.registers[X] = cpu.delayTimer;
+    }
+
+    template<unsigned int X>
+    static void ldVxK(CPU& cpu, uint16_t) {
+        for(int i = 0; i < 16; ++i) {
+            if(cpu.keyboard[i]) {
+                cpu.registers[X] = i;
+
+                return;
+            }
+        }
+
+        cpu.pc -= 2;
+    }
+
+    template<unsigned int X>
+    static void ldDT(CPU& cpu, uint16_t) {
+        cpu.delayTimer = cpu.registers[X];
+    }
+
+    template<unsigned int X>
+    static void ldST(CPU& cpu, uint16_t) {
+        cpu.soundTimer = cpu.registers[X];
+    }
+
+    template<unsigned int X>
+    static void addI(CPU& cpu, uint16_t) {
+        cpu.I += cpu.registers[X];
+    }
+
+    template<unsigned int X>
+    static void ldF(CPU& cpu, uint16_t) {
+        cpu.I = CPU::STARTING_ADDRESS_FONTSET + (5 * cpu.registers[X]);
+    }
+
+    template<unsigned int X>
+    static void ldHF(CPU& cpu, uint16_t) {
+        cpu.I = CPU::STARTING_ADDRESS_LARGE_FONTSET + (10 * (cpu.registers[X] & 0xF));
+    }
+
+    template<unsigned int X>
+    static void ldB(CPU& cpu, uint16_t) {
+        cpu.storeDigits(cpu.registers[X]);
+    }
+
+    template<unsigned int X, class Q>
+    static void ldMemVx(CPU& cpu, uint16_t) {
+        cpu.storeRegisters(X);
+        if(Q::INCREMENT_I) {
+            cpu.I += X + 1;
+        }
+    }
+
+    template<unsigned int X, class Q>
+    static void ldVxMem(CPU& cpu, uint16_t) {
+        cpu.loadRegisters(X);
+        if(Q::INCREMENT_I) {
+            cpu.I += X + 1;
+        }
+    }
+
+    // X is not a register but the planes
+    template<unsigned int X>
+    static void plane(CPU& cpu, uint16_t) {
+        cpu.screen.selectPlanes(X);
+    }
+
+    template<unsigned int X>
+    static void ldRVx(CPU& cpu, uint16_t) {
+        memcpy(cpu.flags, cpu.registers, X + 1);
+    }
+
+    template<unsigned int X>
+    static void ldVxR(CPU& cpu, uint16_t) {
+        memcpy(cpu.registers, cpu.flags, X + 1);
+    }
+
+    typedef std::array<DirectHandler, FAMILY_COUNT> Row;
+
+    /// Handlers of every family for one value of x and y and one quirk
+    /// policy, in the order of Family
+    template<unsigned int XY, class Q>
+    static constexpr Row row() {
+        constexpr unsigned int X = XY >> 4;
+        constexpr unsigned int Y = XY & 0xF;
+
+        return {{
+            &nope, &cls, &ret, &jp, &call, &seKK<X>, &sneKK<X>, &seXY<X, Y>, &ldKK<X>, &addKK<X>,
+            &ldXY<X, Y>, &orXY<X, Y, Q>, &andXY<X, Y, Q>, &xorXY<X, Y, Q>, &addXY<X, Y>, &sub<X, Y>,
+            &shr<X, Y, Q>, &subn<X, Y>, &shl<X, Y, Q>, &sneXY<X, Y>,
+            &ldI, &jpV0<Q>, &rnd<X>, &drw<X, Y, Q>, &skp<X>, &sknp<X>, &ldVxDT<X>, &ldVxK<X>,
+            &ldDT<X>, &ldST<X>, &addI<X>, &ldF<X>, &ldB<X>, &ldMemVx<X, Q>, &ldVxMem<X, Q>,
+            &scd, &scu, &scr, &scl, &halt, &low, &high, &saveXY<X, Y>, &loadXY<X, Y>, &plane<X>,
+            &ldHF<X>, &ldRVx<X>, &ldVxR<X>,
+        }};
+    }
+
+    template<class Q, size_t... XY>
+    static constexpr std::array<DirectHandler, 0x10000> makeTable(std::index_sequence<XY...>) {
+        constexpr Row rows[] = { row<XY, Q>()... };
+
+        std::array<DirectHandler, 0x10000> table {};
+        for(unsigned int opcode = 0; opcode < 0x10000; ++opcode) {
+            table[opcode] = rows[(opcode >> 4) & 0xFF][static_cast<unsigned int>(family(opcode))];
+        }
+
+        return table;
+    }
+};
+
+/// One table per quirk profile, only built for the profiles CPU::setQuirks
+/// instantiates the loops with
+template<class Q>
+static constexpr std::array<DirectHandler, 0x10000> DIRECT_TABLE
+    = DirectDispatch::makeTable<Q>(std::make_index_sequence<0x100>());
+
+// =============================================================================
+// =============================================================================
+// =============================================================================
+// Dispatch Functions
+
+/// A single indirect call per instruction, straight to its handler
+template<bool TRACED, class Q>
+void CPU::runDirect(unsigned int count) {
+    for(unsigned int i = 0; i < count; ++i) {
+        uint16_t address = pc;
+        uint16_t opcode = fetchOpcode(ram, pc);
+        PROFILE_INSTRUCTION(*this, pc, opcode);
+        pc += 2;
+
+        DIRECT_TABLE<Q>[opcode](*this, opcode);
+        if(TRACED) {
+            traceInstruction(address, opcode);
+        }
+    }
+}
+
+static constexpr std::array<uint8_t, 0x10000> makeFamilies() {
+    std::array<uint8_t, 0x10000> families {};
+    for(unsigned int opcode = 0; opcode < 0x10000; ++opcode) {
+        families[opcode] = static_cast<uint8_t>(family(opcode));
+    }
+
+    return families;
+}
+
+static constexpr std::array<uint8_t, 0x10000> FAMILIES = makeFamilies();
+
+/// Threaded code: every handler ends with its own fetch and indirect jump
+/// to the next handler, instead of returning to a shared loop. Uses the
+/// computed gotos of GCC and Clang, and falls back on runDirect elsewhere.
+/// The heavy handlers go through the direct table.
+template<bool TRACED, class Q>
+void CPU::runThreaded(unsigned int count) {
+#if defined(__GNUC__)
+    static void* const LABELS[FAMILY_COUNT] = {
+        &&nope, &&cls, &&ret, &&jp, &&call, &&seKK, &&sneKK, &&seXY, &&ldKK, &&addKK,
+        &&ldXY, &&orXY, &&andXY, &&xorXY, &&addXY, &&sub, &&shr, &&subn, &&shl, &&sneXY,
+        &&ldI, &&jpV0, &&direct, &&direct, &&skp, &&sknp, &&ldVxDT, &&direct,
+        &&ldDT, &&ldST, &&addI, &&ldF, &&direct, &&direct, &&direct,
+        &&direct, &&direct, &&direct, &&direct, &&direct, &&direct, &&direct, &&direct, &&direct, &&direct,
+        &&direct, &&direct, &&direct,
+    };
+
+    uint16_t address;
+    uint16_t opcode;
+
+#define VX registers[(opcode >> 8) & 0xF]
+#define VY registers[(opcode >> 4) & 0xF]
+// Source of the shifts
+#define VS (Q::SHIFT_VY ? VY : VX)
+#define FETCH()                                 \
+    if(count-- == 0) {                          \
+        return;                                 \
+    }                                           \
+    address = pc;                               \
+    opcode = fetchOpcode(ram, pc);              \
+    PROFILE_INSTRUCTION(*this, pc, opcode);     \
+    pc += 2;                                    \
+    goto *LABELS[FAMILIES[opcode]]
+#define NEXT()                                  \
+    if(TRACED) {                                \
+        traceInstruction(address, opcode);      \
+    }                                           \
+    FETCH()
+
+    FETCH();
+
+nope:
+    NEXT();
+cls:
+    screen.clear();
+    NEXT();
+ret:
+    if(sp == 0) {
+        pc -= 2;
+    } else {
+        pc = stack[--sp];
+    }
+    NEXT();
+jp:
+    pc = opcode & 0x0FFFu;
+    NEXT();
+call:
+    if(sp == STACK_SIZE) {
+        pc -= 2;
+    } else {
+        stack[sp++] = pc;
+        pc = opcode & 0x0FFFu;
+    }
+    NEXT();
+seKK:
+    pc += VX == (opcode & 0x00FFu) ? 2 : 0;
+    NEXT();
+sneKK:
+    pc += VX != (opcode & 0x00FFu) ? 2 : 0;
+    NEXT();
+seXY:
+    pc += VX == VY ? 2 : 0;
+    NEXT();
+ldKK:
+    VX = opcode & 0x00FFu;
+    NEXT();
+addKK:
+    VX += opcode & 0x00FFu;
+    NEXT();
+ldXY:
+    VX = VY;
+    NEXT();
+orXY:
+    VX |= VY;
+    if(Q::RESET_VF) {
+        registers[0xF] = 0;
+    }
+    NEXT();
+andXY:
+    VX &= VY;
+    if(Q::RESET_VF) {
+        registers[0xF] = 0;
+    }
+    NEXT();
+xorXY:
+    VX ^= VY;
+    if(Q::RESET_VF) {
+        registers[0xF] = 0;
+    }
+    NEXT();
+addXY: {
+    uint16_t sum = VX + VY;
+    registers[0xF] = sum > 0x0FFu ? 1 : 0;
+    VX = sum & 0x00FFu;
+    NEXT();
+}
+sub:
+    registers[0xF] = VX > VY ? 1 : 0;
+    VX -= VY;
+    NEXT();
+shr:
+    registers[0xF] = VS & 0x1;
+    VX = VS >> 1;
+    NEXT();
+subn:
+    registers[0xF] = VY > VX ? 1 : 0;
+    VX = VY - VX;
+    NEXT();
+shl:
+    registers[0xF] = (VS & 0x80) >> 7;
+    VX = VS << 1;
+    NEXT();
+sneXY:
+    pc += VX != VY ? 2 : 0;
+    NEXT();
+ldI:
+    I = opcode & 0x0FFFu;
+    NEXT();
+jpV0:
+    pc = (Q::JUMP_VX ? VX : registers[0]) + (opcode & 0x0FFFu);
+    NEXT();
+skp:
+    pc += keyboard[VX & 0xF] ? 2 : 0;
+    NEXT();
+sknp:
+    pc += keyboard[VX & 0xF] ? 0 : 2;
+    NEXT();
+ldVxDT:
+    VX = delayTimer;
+    NEXT();
+ldDT:
+    delayTimer = VX;
+    NEXT();
+ldST:
+    soundTimer = VX;
+    NEXT();
+addI:
+    I += VX;
+    NEXT();
+ldF:
+    I = STARTING_ADDRESS_FONTSET + (5 * VX);
+    NEXT();
+direct:
+    DIRECT_TABLE<Q>[opcode](*this, opcode);
+    NEXT();
+
+#undef NEXT
+#undef FETCH
+#undef VS
+#undef VY
+#undef VX
+#else
+    runDirect<TRACED, Q>(count);
+#endif
+}
+
+// runCycles picks between them in cpu.cpp, setQuirks picks the profile
+template void CPU::runDirect<false, ModernQuirks>(unsigned int count);
+template void CPU::runDirect<true, ModernQuirks>(unsigned int count);
+template void CPU::runThreaded<false, ModernQuirks>(unsigned int count);
+template void CPU::runThreaded<true, ModernQuirks>(unsigned int count);
+
+template void CPU::runDirect<false, CosmacVipQuirks>(unsigned int count);
+template void CPU::runDirect<true, CosmacVipQuirks>(unsigned int count);
+template void CPU::runThreaded<false, CosmacVipQuirks>(unsigned int count);
+template void CPU::runThreaded<true, CosmacVipQuirks>(unsigned int count);
+
+template void CPU::runDirect<false, SuperChipQuirks>(unsigned int count);
+template void CPU::runDirect<true, SuperChipQuirks>(unsigned int count);
+template void CPU::runThreaded<false, SuperChipQuirks>(unsigned int count);
+template void CPU::runThreaded<true, SuperChipQuirks>(unsigned int count);
+
+template void CPU::runDirect<false, XoChipQuirks>(unsigned int count);
+template void CPU::runDirect<true, XoChipQuirks>(unsigned int count);
+template void CPU::runThreaded<false, XoChipQuirks>(unsigned int count);
+template void CPU::runThreaded<true, XoChipQuirks>(unsigned int count);
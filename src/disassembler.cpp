@@ -0,0 +1,152 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#include <cstdio>
+
+#include "disassembler.hpp"
+
+static std::string format(const char* pattern, unsigned int a = 0,
+                          unsigned int b = 0, unsigned int c = 0) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), pattern, a, b, c);
+
+    return buffer;
+}
+
+/// Decoded with the masks of family(), so that a trace shows the
+/// instruction the CPU actually ran
+std::string disassemble(uint16_t opcode) {
+    unsigned int x = (opcode >> 8) & 0xFu;
+    unsigned int y = (opcode >> 4) & 0xFu;
+    unsigned int kk = opcode & 0x00FFu;
+    unsigned int n = opcode & 0x000Fu;
+    unsigned int nnn = opcode & 0x0FFFu;
+
+    switch(opcode & 0xF000u) {
+        case 0x0000:
+            if(kk == 0xE0) {
+                return "CLS";
+            }
+            if(kk == 0xEE) {
+                return "RET";
+            }
+            if((kk & 0xF0u) == 0xC0) {
+                return format("SCD %u", n);
+            }
+            if((kk & 0xF0u) == 0xD0) {
+                return format("SCU %u", n);
+            }
+            switch(kk) {
+                case 0xFB:
+                    return "SCR";
+                case 0xFC:
+                    return "SCL";
+                case 0xFD:
+                    return "EXIT";
+                case 0xFE:
+                    return "LOW";
+                case 0xFF:
+                    return "HIGH";
+            }
+            return format("SYS 0x%03X", nnn);
+        case 0x1000:
+            return format("JP 0x%03X", nnn);
+        case 0x2000:
+            return format("CALL 0x%03X", nnn);
+        case 0x3000:
+            return format("SE V%X, 0x%02X", x, kk);
+        case 0x4000:
+            return format("SNE V%X, 0x%02X", x, kk);
+        case 0x5000:
+            if(n == 0x0) {
+                return format("SE V%X, V%X", x, y);
+            }
+            if(n == 0x2) {
+                return format("SAVE V%X - V%X", x, y);
+            }
+            if(n == 0x3) {
+                return format("LOAD V%X - V%X", x, y);
+            }
+            break;
+        case 0x6000:
+            return format("LD V%X, 0x%02X", x, kk);
+        case 0x7000:
+            return format("ADD V%X, 0x%02X", x, kk);
+        case 0x8000:
+            switch(n) {
+                case 0x0:
+                    return format("LD V%X, V%X", x, y);
+                case 0x1:
+                    return format("OR V%X, V%X", x, y);
+                case 0x2:
+                    return format("AND V%X, V%X", x, y);
+                case 0x3:
+                    return format("XOR V%X, V%X", x, y);
+                case 0x4:
+                    return format("ADD V%X, V%X", x, y);
+                case 0x5:
+                    return format("SUB V%X, V%X", x, y);
+                case 0x6:
+                    return format("SHR V%X, V%X", x, y);
+                case 0x7:
+                    return format("SUBN V%X, V%X", x, y);
+                case 0xE:
+                    return format("SHL V%X, V%X", x, y);
+            }
+            break;
+        case 0x9000:
+            return format("SNE V%X, V%X", x, y);
+        case 0xA000:
+            return format("LD I, 0x%03X", nnn);
+        case 0xB000:
+            return format("JP V0, 0x%03X", nnn);
+        case 0xC000:
+            return format("RND V%X, 0x%02X", x, kk);
+        case 0xD000:
+            return format("DRW V%X, V%X, %u", x, y, n);
+        case 0xE000:
+            if(n == 0xE) {
+                return format("SKP V%X", x);
+            }
+            if(n == 0x1) {
+                return format("SKNP V%X", x);
+            }
+            break;
+        case 0xF000:
+            switch(kk) {
+                case 0x01:
+                    return format("PLANE %u", x);
+                case 0x07:
+                    return format("LD V%X, DT", x);
+                case 0x0A:
+                    return format("LD V%X, K", x);
+                case 0x15:
+                    return format("LD DT, V%X", x);
+                case 0x18:
+                    return format("LD ST, V%X", x);
+                case 0x1E:
+                    return format("ADD I, V%X", x);
+                case 0x29:
+                    return format("LD F, V%X", x);
+                case 0x30:
+                    return format("LD HF, V%X", x);
+                case 0x33:
+                    return format("LD B, V%X", x);
+                case 0x55:
+                    return format("LD [I], V%X", x);
+                case 0x65:
+                    return format("LD V%X, [I]", x);
+                case 0x75:
+                    return format("LD R, V%X", x);
+                case 0x85:
+                    return format("LD V%X, R", x);
+            }
+            break;
+    }
+
+    return format("DW 0x%04X", opcode);
+}
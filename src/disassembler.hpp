@@ -0,0 +1,18 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#ifndef disassembler_hpp
+#define disassembler_hpp
+
+#include <cstdint>
+#include <string>
+
+/// Mnemonic of an opcode, e.g. "LD VA, 0x02" for 0x6A02.
+/// Unknown opcodes are rendered as data, e.g. "DW 0x5AB1".
+std::string disassemble(uint16_t opcode);
+
+#endif /* disassembler_hpp */
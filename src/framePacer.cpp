@@ -0,0 +1,64 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#include "framePacer.hpp"
+
+FramePacer::FramePacer(Clock::duration period, Clock::duration spinDuration):
+    period(period), spinDuration(spinDuration), deadline(Clock::now() + period) {
+}
+
+void FramePacer::waitNextFrame() {
+    Clock::time_point now = Clock::now();
+
+    if(deadline - now > spinDuration) {
+        std::this_thread::sleep_until(deadline - spinDuration);
+    }
+
+    // The sleep only wakes up approximately, spin to the deadline itself
+    while((now = Clock::now()) < deadline) {
+        std::this_thread::yield();
+    }
+
+    double lateness = std::chrono::duration<double, std::micro>(now - deadline).count();
+
+    ++frames;
+    double delta = lateness - mean;
+    mean += delta / frames;
+    squaredDeviations += delta * (lateness - mean);
+    max = std::max(max, lateness);
+
+    deadline += period;
+
+    if(now - deadline > period) {
+        Clock::duration late = now - deadline;
+        droppedFrames += late / period;
+        deadline = now + period;
+    }
+}
+
+FramePacer::Jitter FramePacer::jitter() const {
+    Jitter jitter;
+    jitter.frames = frames;
+    jitter.droppedFrames = droppedFrames;
+    jitter.mean = mean;
+    jitter.standardDeviation = frames > 1 ? std::sqrt(squaredDeviations / (frames - 1)) : 0;
+    jitter.max = max;
+
+    return jitter;
+}
+
+void FramePacer::resetJitter() {
+    frames = 0;
+    droppedFrames = 0;
+    mean = 0;
+    squaredDeviations = 0;
+    max = 0;
+}
@@ -0,0 +1,56 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#ifndef framePacer_hpp
+#define framePacer_hpp
+
+#include <chrono>
+#include <cstdint>
+
+/// Paces a loop on fixed deadlines without burning a core: it sleeps until
+/// shortly before the next deadline, then spins for the remaining moment.
+/// The period has the resolution of the steady clock, so it can be a 60 Hz
+/// frame as well as a sub-millisecond instruction budget.
+class FramePacer {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    /// How late the loop woke up after its deadlines, in microseconds
+    struct Jitter {
+        uint64_t frames;
+        uint64_t droppedFrames;
+        double mean;
+        double standardDeviation;
+        double max;
+    };
+
+private:
+    Clock::duration period;
+    Clock::duration spinDuration;
+    Clock::time_point deadline;
+
+    uint64_t frames = 0;
+    uint64_t droppedFrames = 0;
+    // Running mean and sum of squared deviations (Welford)
+    double mean = 0;
+    double squaredDeviations = 0;
+    double max = 0;
+
+public:
+    FramePacer(Clock::duration period,
+               Clock::duration spinDuration = std::chrono::microseconds(500));
+
+    /// Block until the deadline of the next frame. When the loop is more
+    /// than a whole period late, the missed frames are dropped instead of
+    /// being run back to back.
+    void waitNextFrame();
+
+    Jitter jitter() const;
+    void resetJitter();
+};
+
+#endif /* framePacer_hpp */
@@ -0,0 +1,213 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "frameRing.hpp"
+#include "systemError.hpp"
+
+// The atomics below are shared with other processes, which only works when
+// they are not a lock in the memory of one of them
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "64-bit atomics must be lock-free");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "32-bit atomics must be lock-free");
+
+/// Start of the shared memory, followed by the slots
+struct alignas(64) FrameRingHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t slotCount;
+    uint32_t slotSize;
+    std::atomic<uint32_t> closed;
+    // Frames published since the start
+    std::atomic<uint64_t> head;
+};
+
+struct alignas(64) FrameRingSlot {
+    // 2 * sequence + 1 while frame `sequence` is written, 2 * sequence + 2
+    // once it is
+    std::atomic<uint64_t> lock;
+    SharedFrame frame;
+};
+
+// POSIX wants a single leading slash
+static std::string objectName(const char* name) {
+    return name[0] == '/' ? std::string(name) : "/" + std::string(name);
+}
+
+// ===========================================================================
+// ===========================================================================
+// ===========================================================================
+// Writer
+
+FrameRing::FrameRing(const char* name, unsigned int slots): name(objectName(name)) {
+    if(slots == 0 || slots > UINT16_MAX) {
+        throw std::runtime_error("A frame ring has 1 to 65535 slots, not " + std::to_string(slots));
+    }
+
+    length = sizeof(FrameRingHeader) + slots * sizeof(FrameRingSlot);
+
+    // Readers still attached to a ring left behind keep the old one
+    shm_unlink(this->name.c_str());
+
+    int fd = shm_open(this->name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if(fd < 0) {
+        throw systemError("Cannot create frame ring " + this->name);
+    }
+
+    if(ftruncate(fd, length) != 0) {
+        close(fd);
+        shm_unlink(this->name.c_str());
+        throw systemError("Cannot size frame ring " + this->name);
+    }
+
+    void* address = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if(address == MAP_FAILED) {
+        shm_unlink(this->name.c_str());
+        throw systemError("Cannot map frame ring " + this->name);
+    }
+
+    // The object starts zeroed, so every lock is 0 and no slot reads as a
+    // published frame
+    header = new(address) FrameRingHeader;
+    header->magic = MAGIC;
+    header->version = VERSION;
+    header->slotCount = slots;
+    header->slotSize = sizeof(FrameRingSlot);
+    header->closed.store(0, std::memory_order_relaxed);
+    header->head.store(0, std::memory_order_release);
+
+    this->slots = reinterpret_cast<FrameRingSlot*>(header + 1);
+}
+
+FrameRing::~FrameRing() {
+    header->closed.store(1, std::memory_order_release);
+
+    munmap(header, length);
+    shm_unlink(name.c_str());
+}
+
+void FrameRing::publish(const uint64_t* bits, uint64_t generation, bool hires, unsigned int planes) {
+    uint64_t sequence = header->head.load(std::memory_order_relaxed);
+    FrameRingSlot& slot = slots[sequence % header->slotCount];
+
+    // Odd first: a reader that copies any of what follows sees the lock
+    // move when it checks it again
+    slot.lock.store(2 * sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.frame.sequence = sequence;
+    slot.frame.generation = generation;
+    slot.frame.timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    slot.frame.hires = hires;
+    slot.frame.planes = planes;
+    memcpy(slot.frame.bits, bits, sizeof(slot.frame.bits));
+
+    slot.lock.store(2 * sequence + 2, std::memory_order_release);
+    header->head.store(sequence + 1, std::memory_order_release);
+}
+
+uint64_t FrameRing::size() const {
+    return header->head.load(std::memory_order_relaxed);
+}
+
+// ===========================================================================
+// ===========================================================================
+// ===========================================================================
+// Reader
+
+FrameRingReader::FrameRingReader(const char* name) {
+    std::string object = objectName(name);
+
+    int fd = shm_open(object.c_str(), O_RDONLY, 0);
+    if(fd < 0) {
+        throw systemError("Cannot open frame ring " + object);
+    }
+
+    struct stat status;
+    if(fstat(fd, &status) != 0 || static_cast<size_t>(status.st_size) < sizeof(FrameRingHeader)) {
+        close(fd);
+        throw std::runtime_error("Frame ring " + object + " is not a frame ring");
+    }
+
+    length = status.st_size;
+    void* address = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if(address == MAP_FAILED) {
+        throw systemError("Cannot map frame ring " + object);
+    }
+
+    header = static_cast<const FrameRingHeader*>(address);
+
+    if(header->magic != FrameRing::MAGIC || header->version != FrameRing::VERSION
+       || header->slotSize != sizeof(FrameRingSlot) || header->slotCount == 0
+       || length < sizeof(FrameRingHeader) + header->slotCount * sizeof(FrameRingSlot)) {
+        munmap(address, length);
+        throw std::runtime_error("Frame ring " + object + " is of another version");
+    }
+
+    slotCount = header->slotCount;
+    slots = reinterpret_cast<const FrameRingSlot*>(header + 1);
+}
+
+FrameRingReader::~FrameRingReader() {
+    munmap(const_cast<FrameRingHeader*>(header), length);
+}
+
+uint64_t FrameRingReader::size() const {
+    return header->head.load(std::memory_order_acquire);
+}
+
+bool FrameRingReader::read(uint64_t sequence, SharedFrame& frame) const {
+    const FrameRingSlot& slot = slots[sequence % slotCount];
+
+    if(slot.lock.load(std::memory_order_acquire) != 2 * sequence + 2) {
+        return false;
+    }
+
+    memcpy(&frame, &slot.frame, sizeof(frame));
+
+    // The copy is done before the lock is read again
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot.lock.load(std::memory_order_relaxed) == 2 * sequence + 2;
+}
+
+bool FrameRingReader::readLatest(SharedFrame& frame) const {
+    // The emulator lapped the whole ring during the copy when the head
+    // moved on, the frame it reached is read instead
+    for(;;) {
+        uint64_t head = size();
+
+        if(head == 0) {
+            return false;
+        }
+
+        if(read(head - 1, frame)) {
+            return true;
+        }
+
+        if(size() == head) {
+            return false;
+        }
+    }
+}
+
+bool FrameRingReader::isClosed() const {
+    return header->closed.load(std::memory_order_acquire) != 0;
+}
@@ -0,0 +1,127 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#ifndef frameRing_hpp
+#define frameRing_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "framebuffer.hpp"
+
+/// A frame as published in a FrameRing: the bitplanes of the Framebuffer,
+/// laid out the same way, and where the frame stands in the run
+struct SharedFrame {
+    // Index of the frame in the ring, from 0 when the ring was created
+    uint64_t sequence;
+    // Framebuffer::generation, unchanged when the frame drew nothing
+    uint64_t generation;
+    // Steady clock of the host when the frame ended, in nanoseconds
+    uint64_t timestamp;
+    uint32_t hires;
+    uint32_t planes;
+    uint64_t bits[Framebuffer::PLANES][Framebuffer::WORDS][Framebuffer::HIRES_HEIGHT];
+
+    unsigned int width() const {
+        return hires ? Framebuffer::HIRES_WIDTH : Framebuffer::WIDTH;
+    }
+
+    unsigned int height() const {
+        return hires ? Framebuffer::HIRES_HEIGHT : Framebuffer::HEIGHT;
+    }
+
+    /// Color of a pixel, its bit in each plane, see Framebuffer::pixel
+    unsigned int pixel(unsigned int x, unsigned int y) const {
+        unsigned int shift = 63 - x % 64;
+        return ((bits[0][x / 64][y] >> shift) & 0x1u) | (((bits[1][x / 64][y] >> shift) & 0x1u) << 1);
+    }
+};
+
+struct FrameRingHeader;
+struct FrameRingSlot;
+
+/// Ring of the last frames in POSIX shared memory, for recorders,
+/// dashboards and other processes of the host to follow a running
+/// emulator. Install it with CPU::setFrameRing, the CPU publishes a frame
+/// at the end of each runFrame.
+///
+/// Publishing copies the planes into the next slot and never waits for a
+/// reader: each slot is a seqlock, its sequence odd while it is written.
+/// A reader copies a slot, then checks that its sequence did not move, so
+/// a reader falling a whole ring behind loses frames instead of holding
+/// the emulator back. Readers attach and detach at any time, see
+/// FrameRingReader.
+///
+/// The shared memory object is unlinked when the ring is destroyed,
+/// readers still attached keep their mapping and see the ring closed.
+class FrameRing {
+public:
+    static const uint32_t MAGIC = 0x52463843; // "C8FR"
+    static const uint16_t VERSION = 1;
+    static const unsigned int DEFAULT_SLOTS = 8;
+
+private:
+    std::string name;
+    FrameRingHeader* header = nullptr;
+    FrameRingSlot* slots = nullptr;
+    size_t length = 0;
+
+    void publish(const uint64_t* bits, uint64_t generation, bool hires, unsigned int planes);
+
+public:
+    /// Create the shared memory object `name`, e.g. "/chip8", replacing
+    /// any left by an emulator that did not exit cleanly. Throws
+    /// std::runtime_error when it cannot be created.
+    explicit FrameRing(const char* name, unsigned int slots = DEFAULT_SLOTS);
+    ~FrameRing();
+
+    FrameRing(const FrameRing&) = delete;
+    FrameRing& operator=(const FrameRing&) = delete;
+
+    void publish(const Framebuffer& framebuffer) {
+        publish(&framebuffer.bits[0][0][0], framebuffer.generation, framebuffer.isHires(),
+                framebuffer.selectedPlanes());
+    }
+
+    /// Frames published so far
+    uint64_t size() const;
+};
+
+/// Read side of a FrameRing, in another process. Only maps the ring, so
+/// attaching or detaching is invisible to the emulator.
+class FrameRingReader {
+private:
+    const FrameRingHeader* header = nullptr;
+    const FrameRingSlot* slots = nullptr;
+    unsigned int slotCount = 0;
+    size_t length = 0;
+
+public:
+    /// Throws std::runtime_error when there is no ring named `name`, or of
+    /// another version
+    explicit FrameRingReader(const char* name);
+    ~FrameRingReader();
+
+    FrameRingReader(const FrameRingReader&) = delete;
+    FrameRingReader& operator=(const FrameRingReader&) = delete;
+
+    /// Frames published so far, the next frame to come is this one
+    uint64_t size() const;
+
+    /// Copy frame `sequence`. Returns false when it is not published yet,
+    /// or already overwritten, including while it was being copied.
+    bool read(uint64_t sequence, SharedFrame& frame) const;
+
+    /// Copy the last frame published. Returns false when there is none.
+    bool readLatest(SharedFrame& frame) const;
+
+    /// Whether the emulator destroyed the ring: no frame will come anymore
+    bool isClosed() const;
+};
+
+#endif /* frameRing_hpp */
@@ -0,0 +1,302 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#include <algorithm>
+#include <cstring>
+
+#include "framebuffer.hpp"
+
+const uint32_t Framebuffer::PALETTE[1u << PLANES] = {
+    0x00000000, 0xFFFFFFFF, 0xAAAAAAFF, 0x555555FF
+};
+
+Framebuffer::Framebuffer() {
+    memset(bits, 0, sizeof(bits));
+}
+
+bool Framebuffer::isHires() const {
+    return hires;
+}
+
+unsigned int Framebuffer::width() const {
+    return hires ? HIRES_WIDTH : WIDTH;
+}
+
+unsigned int Framebuffer::height() const {
+    return hires ? HIRES_HEIGHT : HEIGHT;
+}
+
+void Framebuffer::setHires(bool hires) {
+    this->hires = hires;
+
+    memset(bits, 0, sizeof(bits));
+    touch(0, HIRES_HEIGHT);
+}
+
+unsigned int Framebuffer::selectedPlanes() const {
+    return planes;
+}
+
+void Framebuffer::selectPlanes(unsigned int planes) {
+    this->planes = planes & ALL_PLANES;
+}
+
+/// Pixels out of the display are always off, only the visible ones are
+/// cleared
+void Framebuffer::clear() {
+    unsigned int words = hires ? WORDS : 1;
+
+    for(unsigned int plane = 0; plane < PLANES; ++plane) {
+        if(planes & (1u << plane)) {
+            for(unsigned int word = 0; word < words; ++word) {
+                memset(bits[plane][word], 0, height() * sizeof(uint64_t));
+            }
+        }
+    }
+
+    touch(0, height());
+}
+
+void Framebuffer::load(const uint64_t* bits, bool hires, unsigned int planes) {
+    memcpy(this->bits, bits, sizeof(this->bits));
+    this->hires = hires;
+    selectPlanes(planes);
+
+    touch(0, HIRES_HEIGHT);
+}
+
+bool Framebuffer::dirtyRows(uint64_t since, unsigned int& begin, unsigned int& end) const {
+    if(generation == since) {
+        return false;
+    }
+
+    begin = 0;
+    while(begin < height() && rowGenerations[begin] <= since) {
+        ++begin;
+    }
+
+    end = height();
+    while(end > begin && rowGenerations[end - 1] <= since) {
+        --end;
+    }
+
+    return begin < end;
+}
+
+/// XOR `lines` lines of a sprite into a plane from row y, and return the
+/// lit pixels switched off. Bits shifted past the right edge are dropped,
+/// or with WRAP come back from the left edge. In low resolution the second
+/// word is past the right edge.
+template<unsigned int SPRITE_WIDTH, bool HIRES, bool WRAP>
+static uint64_t xorLines(uint64_t (*words)[Framebuffer::HIRES_HEIGHT], unsigned int x,
+                         unsigned int y, const uint8_t* sprite, unsigned int lines) {
+    const unsigned int BYTES_PER_LINE = SPRITE_WIDTH / 8;
+    uint64_t* first = &words[0][y];
+    uint64_t* second = &words[1][y];
+    uint64_t collision = 0;
+
+    for(unsigned int i = 0; i < lines; ++i) {
+        uint64_t line = sprite[BYTES_PER_LINE * i];
+        if(BYTES_PER_LINE == 2) {
+            line = (line << 8) | sprite[BYTES_PER_LINE * i + 1];
+        }
+        line <<= 64 - SPRITE_WIDTH;
+
+        if(!HIRES) {
+            // A rotation when wrapping, x = 0 included
+            line = WRAP ? (line >> x) | (line << ((64 - x) & 63)) : line >> x;
+            collision |= first[i] & line;
+            first[i] ^= line;
+        } else {
+            uint64_t left = x < 64 ? line >> x : WRAP && x > 64 ? line << (128 - x) : 0;
+            uint64_t right = x == 0 ? 0 : x < 64 ? line << (64 - x) : line >> (x - 64);
+
+            collision |= (first[i] & left) | (second[i] & right);
+            first[i] ^= left;
+            second[i] ^= right;
+        }
+    }
+
+    return collision;
+}
+
+/// The lines of a sprite in one plane: those above the bottom edge, then
+/// with WRAP the `wrapped` ones left, from the top row
+template<unsigned int SPRITE_WIDTH, bool HIRES, bool WRAP>
+static uint64_t xorSprite(uint64_t (*words)[Framebuffer::HIRES_HEIGHT], unsigned int x,
+                          unsigned int y, const uint8_t* sprite, unsigned int visible,
+                          unsigned int wrapped) {
+    uint64_t collision = xorLines<SPRITE_WIDTH, HIRES, WRAP>(words, x, y, sprite, visible);
+
+    if(WRAP && wrapped > 0) {
+        collision |= xorLines<SPRITE_WIDTH, HIRES, WRAP>(words, x, 0, sprite + SPRITE_WIDTH / 8 * visible,
+                                                         wrapped);
+    }
+
+    return collision;
+}
+
+template<unsigned int SPRITE_WIDTH, bool WRAP>
+bool Framebuffer::draw(unsigned int x, unsigned int y, const uint8_t* sprite, unsigned int lines) {
+    if(lines == 0) {
+        return false;
+    }
+
+    unsigned int visible = std::min(lines, height() - y);
+    unsigned int wrapped = WRAP ? lines - visible : 0;
+    uint64_t collision = 0;
+
+    // A plain CHIP-8 only ever draws this way
+    if(!hires && planes == 0x1) {
+        collision = xorSprite<SPRITE_WIDTH, false, WRAP>(bits[0], x, y, sprite, visible, wrapped);
+    } else {
+        for(unsigned int plane = 0; plane < PLANES; ++plane) {
+            if(planes & (1u << plane)) {
+                collision |= hires
+                    ? xorSprite<SPRITE_WIDTH, true, WRAP>(bits[plane], x, y, sprite, visible, wrapped)
+                    : xorSprite<SPRITE_WIDTH, false, WRAP>(bits[plane], x, y, sprite, visible, wrapped);
+
+                // Each plane has its own lines of the sprite
+                sprite += SPRITE_WIDTH / 8 * lines;
+            }
+        }
+    }
+
+    touch(y, y + visible);
+    if(wrapped > 0) {
+        touch(0, wrapped);
+    }
+
+    return collision != 0;
+}
+
+template<bool WRAP>
+bool Framebuffer::drawSprite(unsigned int x, unsigned int y, const uint8_t* sprite,
+                             unsigned int height) {
+    return draw<8, WRAP>(x, y, sprite, height);
+}
+
+template<bool WRAP>
+bool Framebuffer::drawLargeSprite(unsigned int x, unsigned int y, const uint8_t* sprite) {
+    return draw<16, WRAP>(x, y, sprite, 16);
+}
+
+template bool Framebuffer::drawSprite<false>(unsigned int x, unsigned int y, const uint8_t* sprite,
+                                             unsigned int height);
+template bool Framebuffer::drawSprite<true>(unsigned int x, unsigned int y, const uint8_t* sprite,
+                                            unsigned int height);
+template bool Framebuffer::drawLargeSprite<false>(unsigned int x, unsigned int y, const uint8_t* sprite);
+template bool Framebuffer::drawLargeSprite<true>(unsigned int x, unsigned int y, const uint8_t* sprite);
+
+void Framebuffer::scrollDown(unsigned int n) {
+    unsigned int lines = height();
+    unsigned int words = hires ? WORDS : 1;
+    n = std::min(n, lines);
+
+    for(unsigned int plane = 0; plane < PLANES; ++plane) {
+        if(planes & (1u << plane)) {
+            for(unsigned int word = 0; word < words; ++word) {
+                uint64_t* column = bits[plane][word];
+
+                memmove(column + n, column, (lines - n) * sizeof(uint64_t));
+                memset(column, 0, n * sizeof(uint64_t));
+            }
+        }
+    }
+
+    touch(0, lines);
+}
+
+void Framebuffer::scrollUp(unsigned int n) {
+    unsigned int lines = height();
+    unsigned int words = hires ? WORDS : 1;
+    n = std::min(n, lines);
+
+    for(unsigned int plane = 0; plane < PLANES; ++plane) {
+        if(planes & (1u << plane)) {
+            for(unsigned int word = 0; word < words; ++word) {
+                uint64_t* column = bits[plane][word];
+
+                memmove(column, column + n, (lines - n) * sizeof(uint64_t));
+                memset(column + lines - n, 0, n * sizeof(uint64_t));
+            }
+        }
+    }
+
+    touch(0, lines);
+}
+
+void Framebuffer::scrollRight() {
+    for(unsigned int plane = 0; plane < PLANES; ++plane) {
+        if(!(planes & (1u << plane))) {
+            continue;
+        }
+
+        uint64_t* first = bits[plane][0];
+        uint64_t* second = bits[plane][1];
+
+        for(unsigned int y = 0; y < height(); ++y) {
+            if(hires) {
+                second[y] = (second[y] >> 4) | (first[y] << 60);
+            }
+            first[y] >>= 4;
+        }
+    }
+
+    touch(0, height());
+}
+
+void Framebuffer::scrollLeft() {
+    for(unsigned int plane = 0; plane < PLANES; ++plane) {
+        if(!(planes & (1u << plane))) {
+            continue;
+        }
+
+        uint64_t* first = bits[plane][0];
+        uint64_t* second = bits[plane][1];
+
+        for(unsigned int y = 0; y < height(); ++y) {
+            first[y] <<= 4;
+            if(hires) {
+                first[y] |= second[y] >> 60;
+                second[y] <<= 4;
+            }
+        }
+    }
+
+    touch(0, height());
+}
+
+unsigned int Framebuffer::pixel(unsigned int x, unsigned int y) const {
+    unsigned int color = 0;
+
+    for(unsigned int plane = 0; plane < PLANES; ++plane) {
+        color |= ((bits[plane][x / 64][y] >> (63 - x % 64)) & 0x1u) << plane;
+    }
+
+    return color;
+}
+
+void Framebuffer::expand(uint32_t* pixels, unsigned int begin, unsigned int end,
+                         const uint32_t* palette) const {
+    unsigned int columns = width();
+
+    for(unsigned int y = begin; y < end; ++y) {
+        for(unsigned int x = 0; x < columns; ++x) {
+            pixels[y * columns + x] = palette[pixel(x, y)];
+        }
+    }
+}
+
+void Framebuffer::touch(unsigned int begin, unsigned int end) {
+    // A local, or the generation would be read again after every store
+    uint64_t stamp = ++generation;
+
+    for(unsigned int y = begin; y < end; ++y) {
+        rowGenerations[y] = stamp;
+    }
+}
@@ -0,0 +1,114 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#ifndef framebuffer_hpp
+#define framebuffer_hpp
+
+#include <cstdint>
+
+/// Display of the CHIP-8 and of its SUPER-CHIP and XO-CHIP extensions.
+///
+/// Each bitplane holds one bit per pixel, a row being WORDS 64-bit words.
+/// The most significant bit of the first word of a row is its leftmost
+/// pixel. A plane is stored word by word: bits[plane][0] are the first
+/// words of all the rows, so in low resolution, where only the first word
+/// of the first HEIGHT rows is used, drawing and clearing cost the same as
+/// on a plain CHIP-8. Scrolls are shifts of words or moves of whole rows.
+///
+/// The bits of a pixel in the planes give its color, an index into a
+/// palette of 4 colors.
+class Framebuffer {
+public:
+    // Low resolution, the one of the CHIP-8
+    static const unsigned int WIDTH = 64;
+    static const unsigned int HEIGHT = 32;
+
+    // High resolution of the SUPER-CHIP
+    static const unsigned int HIRES_WIDTH = 128;
+    static const unsigned int HIRES_HEIGHT = 64;
+
+    static const unsigned int WORDS = HIRES_WIDTH / 64;
+    static const unsigned int PLANES = 2;
+    static const unsigned int ALL_PLANES = (1u << PLANES) - 1;
+
+    // Off, first plane, second plane, both
+    static const uint32_t PALETTE[1u << PLANES];
+
+    uint64_t bits[PLANES][WORDS][HIRES_HEIGHT];
+
+    // Incremented on every change of the display. A row is stamped with the
+    // generation that last changed it, so each consumer can find what
+    // changed since the generation it last presented.
+    uint64_t generation = 0;
+    uint64_t rowGenerations[HIRES_HEIGHT] = {};
+
+private:
+    bool hires = false;
+
+    // Planes drawn, scrolled and cleared, see XO-CHIP's Fn01
+    unsigned int planes = 0x1;
+
+public:
+    Framebuffer();
+
+    bool isHires() const;
+    unsigned int width() const;
+    unsigned int height() const;
+
+    /// Switch between low and high resolution, which clears every plane
+    void setHires(bool hires);
+
+    unsigned int selectedPlanes() const;
+    void selectPlanes(unsigned int planes);
+
+    /// Clear the selected planes
+    void clear();
+
+    /// Replace the whole display, e.g. when a state is loaded
+    void load(const uint64_t* bits, bool hires, unsigned int planes);
+
+    /// Range [begin, end) of the rows changed after generation `since`.
+    /// Returns false when nothing changed.
+    bool dirtyRows(uint64_t since, unsigned int& begin, unsigned int& end) const;
+
+    /// XOR a sprite of `height` rows of 8 pixels at (x, y), x < width()
+    /// and y < height(), in each selected plane. Each plane takes the next
+    /// `height` bytes of the sprite. What goes past the right or bottom
+    /// edge is clipped, or with WRAP drawn at the opposite edge. Returns
+    /// whether a lit pixel was switched off.
+    template<bool WRAP = false>
+    bool drawSprite(unsigned int x, unsigned int y, const uint8_t* sprite,
+                    unsigned int height);
+
+    /// Same with a sprite of 16x16 pixels, 32 bytes per plane
+    template<bool WRAP = false>
+    bool drawLargeSprite(unsigned int x, unsigned int y, const uint8_t* sprite);
+
+    /// Scroll the selected planes by `n` rows, or by 4 pixels for left and
+    /// right. What scrolls in is off.
+    void scrollDown(unsigned int n);
+    void scrollUp(unsigned int n);
+    void scrollRight();
+    void scrollLeft();
+
+    /// Color of a pixel, its bit in each plane
+    unsigned int pixel(unsigned int x, unsigned int y) const;
+
+    /// Expand the rows [begin, end) into a buffer of width() * height()
+    /// RGBA pixels, a pixel at a time. Displays go through the kernels of
+    /// Presenter instead, this is what they must match.
+    void expand(uint32_t* pixels, unsigned int begin, unsigned int end,
+                const uint32_t* palette = PALETTE) const;
+
+private:
+    template<unsigned int SPRITE_WIDTH, bool WRAP>
+    bool draw(unsigned int x, unsigned int y, const uint8_t* sprite, unsigned int height);
+
+    void touch(unsigned int begin, unsigned int end);
+};
+
+#endif /* framebuffer_hpp */
@@ -0,0 +1,101 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#include "frameRing.hpp"
+
+/// chip8-frames: follows the frame ring of a running emulator, see
+/// FrameRing, and prints once per second the frames it read, lost and saw
+/// drawing, and how long after the end of their frame it read them. With
+/// --dump, the last frame is printed as text as well.
+///
+/// It is the smallest consumer of the ring, started and stopped at any
+/// time without the emulator noticing.
+
+static const std::chrono::milliseconds POLL_PERIOD(2);
+static const std::chrono::seconds REPORT_PERIOD(1);
+
+static void usage(const char* program) {
+    std::cerr << "Usage: " << program << " FrameRingName [--dump]" << std::endl;
+    std::exit(EXIT_FAILURE);
+}
+
+static uint64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void dump(const SharedFrame& frame) {
+    for(unsigned int y = 0; y < frame.height(); ++y) {
+        for(unsigned int x = 0; x < frame.width(); ++x) {
+            std::cout << " #+@"[frame.pixel(x, y)];
+        }
+        std::cout << std::endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if(argc != 2 && !(argc == 3 && !strcmp(argv[2], "--dump"))) {
+        usage(argv[0]);
+    }
+
+    bool dumping = argc == 3;
+
+    try {
+        FrameRingReader reader(argv[1]);
+        SharedFrame frame;
+
+        // Frames published before attaching are not counted as lost
+        uint64_t next = reader.size();
+        uint64_t generation = 0;
+        uint64_t read = 0, lost = 0, drawn = 0, delay = 0;
+        auto report = std::chrono::steady_clock::now() + REPORT_PERIOD;
+
+        while(!reader.isClosed()) {
+            uint64_t head = reader.size();
+
+            for(; next < head; ++next) {
+                if(!reader.read(next, frame)) {
+                    ++lost;
+                    continue;
+                }
+
+                ++read;
+                delay += now() - frame.timestamp;
+                drawn += frame.generation != generation;
+                generation = frame.generation;
+            }
+
+            if(std::chrono::steady_clock::now() >= report) {
+                std::cout << "frame " << next << ": " << read << " read, " << lost << " lost, "
+                          << drawn << " drawing, read " << (read ? delay / read / 1000 : 0)
+                          << " us after their end" << std::endl;
+
+                if(dumping && reader.readLatest(frame)) {
+                    dump(frame);
+                }
+
+                read = lost = drawn = delay = 0;
+                report += REPORT_PERIOD;
+            }
+
+            std::this_thread::sleep_for(POLL_PERIOD);
+        }
+
+        std::cout << "frame ring closed after " << next << " frames" << std::endl;
+    } catch(const std::exception& exception) {
+        std::cerr << "Error: " << exception.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return 0;
+}
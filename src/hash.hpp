@@ -0,0 +1,30 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#ifndef hash_hpp
+#define hash_hpp
+
+#include <cstddef>
+#include <cstdint>
+
+static const uint64_t HASH_SEED = 0xCBF29CE484222325ull;
+
+/// 64-bit FNV-1a, used to identify ROMs and to digest emulator state.
+/// Pass the previous result as seed to hash several buffers together.
+inline uint64_t hashBytes(const void* data, size_t size, uint64_t seed = HASH_SEED) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint64_t hash = seed;
+
+    for(size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 0x100000001B3ull;
+    }
+
+    return hash;
+}
+
+#endif /* hash_hpp */
@@ -0,0 +1,212 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#include <algorithm>
+#include <cstring>
+
+#include "cpu.hpp"
+#include "opcodeFamily.hpp"
+#include "profile.hpp"
+
+/// Idle loops: a ROM waiting for a key with Fx0A, halted on a jump to
+/// itself or 00FD, or polling the delay timer or the keys in a loop like
+/// "Fx07, 3x00, 1nnn".
+///
+/// The delay timer only ticks and the keys only change between two calls
+/// of runCycles. So from the pc, the loop is run ahead on a copy of the
+/// registers. When an iteration leaves them exactly as it found them, every
+/// following one until the end of runCycles does the same, and the CPU can
+/// jump over as many whole iterations as fit in the instructions left. The
+/// state afterwards is the one the instructions would have left, only the
+/// trace and the instruction counters miss them.
+
+bool CPU::IdleProbe::operator==(const IdleProbe& other) const {
+    return I == other.I && pc == other.pc && sp == other.sp
+        && memcmp(registers, other.registers, sizeof(registers)) == 0
+        && memcmp(stack, other.stack, sizeof(stack)) == 0;
+}
+
+/// Run one iteration of the loop at probe.pc on the probe, and return its
+/// number of instructions. Returns 0 when it is not an idle loop: an
+/// instruction writes to more than the probe, or the pc is not back after
+/// MAX_IDLE_LOOP instructions.
+unsigned int CPU::probeIdle(IdleProbe& probe, bool& readsTimer, bool& readsKeys) const {
+    uint16_t start = probe.pc;
+    uint8_t* V = probe.registers;
+
+    for(unsigned int length = 1; length <= MAX_IDLE_LOOP; ++length) {
+        uint16_t opcode = (ram[probe.pc & (RAM_SIZE - 1)] << 8u) | ram[(probe.pc + 1) & (RAM_SIZE - 1)];
+        uint8_t x = (opcode >> 8) & 0xF;
+        uint8_t y = (opcode >> 4) & 0xF;
+        uint8_t kk = opcode & 0x00FFu;
+        uint16_t nnn = opcode & 0x0FFFu;
+
+        probe.pc += 2;
+
+        switch(family(opcode)) {
+            case Family::NOPE:
+                break;
+            case Family::EXIT:
+                probe.pc -= 2;
+                break;
+            case Family::RET:
+                if(probe.sp == 0) {
+                    probe.pc -= 2;
+                    break;
+                }
+                probe.pc = probe.stack[--probe.sp];
+                break;
+            case Family::JP:
+                probe.pc = nnn;
+                break;
+            case Family::CALL:
+                if(probe.sp == STACK_SIZE) {
+                    probe.pc -= 2;
+                    break;
+                }
+                probe.stack[probe.sp++] = probe.pc;
+                probe.pc = nnn;
+                break;
+            case Family::SE_KK:
+                probe.pc += V[x] == kk ? 2 : 0;
+                break;
+            case Family::SNE_KK:
+                probe.pc += V[x] != kk ? 2 : 0;
+                break;
+            case Family::SE_XY:
+                probe.pc += V[x] == V[y] ? 2 : 0;
+                break;
+            case Family::SNE_XY:
+                probe.pc += V[x] != V[y] ? 2 : 0;
+                break;
+            case Family::LD_KK:
+                V[x] = kk;
+                break;
+            case Family::ADD_KK:
+                V[x] += kk;
+                break;
+            case Family::LD_XY:
+                V[x] = V[y];
+                break;
+            case Family::LD_I:
+                probe.I = nnn;
+                break;
+            case Family::ADD_I:
+                probe.I += V[x];
+                break;
+            case Family::LD_VX_DT:
+                V[x] = delayTimer;
+                readsTimer = true;
+                break;
+            case Family::SKP:
+            case Family::SKNP:
+                probe.pc += (keyboard[V[x] & 0xF] != 0) == (family(opcode) == Family::SKP) ? 2 : 0;
+                readsKeys = true;
+                break;
+            case Family::LD_VX_K: {
+                readsKeys = true;
+
+                unsigned int key = 0;
+                while(key < KEYBOARD_SIZE && !keyboard[key]) {
+                    ++key;
+                }
+
+                if(key < KEYBOARD_SIZE) {
+                    V[x] = key;
+                } else {
+                    probe.pc -= 2;
+                }
+                break;
+            }
+            default:
+                return 0;
+        }
+
+        if(probe.pc == start) {
+            return length;
+        }
+    }
+
+    return 0;
+}
+
+/// Called at the start of runCycles with the instructions to run. Returns
+/// how many are left to interpret after jumping over the idle ones.
+unsigned int CPU::skipIdle(unsigned int count) {
+    idle = Idle::None;
+
+    // Probing a running ROM on every frame would cost about as much as
+    // the instructions of the frame
+    if(idleCountdown > 0) {
+        --idleCountdown;
+        return count;
+    }
+
+    IdleProbe first;
+    memcpy(first.registers, registers, sizeof(registers));
+    memcpy(first.stack, stack, sizeof(stack));
+    first.I = I;
+    first.pc = pc;
+    first.sp = sp;
+
+    bool readsTimer = false;
+    bool readsKeys = false;
+
+    // The first iteration can still change the registers, e.g. Vx = DT
+    // after a tick, so the loop has to be stable from the second one
+    unsigned int length = probeIdle(first, readsTimer, readsKeys);
+    unsigned int period = 0;
+
+    IdleProbe second = first;
+    if(length > 0) {
+        readsTimer = false;
+        readsKeys = false;
+        period = probeIdle(second, readsTimer, readsKeys);
+    }
+
+    if(period == 0 || !(second == first)) {
+        idleBackoff = std::min(std::max(2 * idleBackoff, 1u), MAX_IDLE_BACKOFF);
+        idleCountdown = idleBackoff;
+
+        return count;
+    }
+
+    idleBackoff = 0;
+
+    // A delay timer at 0 stays there
+    if(readsTimer && delayTimer > 0) {
+        idle = Idle::Timer;
+    } else if(readsKeys) {
+        idle = Idle::Key;
+    } else {
+        idle = Idle::Halted;
+    }
+
+    if(!idleSkipping || count < length) {
+        return count;
+    }
+
+    memcpy(registers, first.registers, sizeof(registers));
+    memcpy(stack, first.stack, sizeof(stack));
+    I = first.I;
+    pc = first.pc;
+    sp = first.sp;
+
+    count -= length;
+    unsigned int skipped = count - count % period;
+    PROFILE_IDLE(*this, length + skipped);
+
+    return count - skipped;
+}
+
+CPU::Idle CPU::getIdle() const {
+    return idle;
+}
+
+void CPU::setIdleSkipping(bool idleSkipping) {
+    this->idleSkipping = idleSkipping;
+}
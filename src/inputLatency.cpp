@@ -0,0 +1,101 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#include <algorithm>
+#include <iomanip>
+#include <string>
+
+#include "inputLatency.hpp"
+
+static const unsigned int BAR_WIDTH = 40;
+
+void InputLatency::keyPressed(Clock::time_point arrival, uint64_t generation) {
+    pending.push_back({ arrival, generation });
+}
+
+void InputLatency::presented(Clock::time_point time, uint64_t generation) {
+    size_t answered = 0;
+
+    for(const Pending& key: pending) {
+        double latency = std::chrono::duration<double, std::milli>(time - key.arrival).count();
+
+        if(key.generation != generation) {
+            ++keys;
+            ++buckets[std::min(static_cast<unsigned int>(std::max(latency, 0.0)), BUCKETS - 1)];
+            max = std::max(max, latency);
+            ++answered;
+        } else if(latency > RESPONSE_TIMEOUT) {
+            ++withoutResponse;
+            ++answered;
+        } else {
+            break;
+        }
+    }
+
+    // Keys come in order, so the ones answered are the oldest
+    pending.erase(pending.begin(), pending.begin() + answered);
+}
+
+/// Upper edge of the bucket holding the key at `share` of the keys
+double InputLatency::percentile(double share) const {
+    uint64_t rank = static_cast<uint64_t>(share * keys);
+    uint64_t count = 0;
+
+    for(unsigned int bucket = 0; bucket < BUCKETS; ++bucket) {
+        count += buckets[bucket];
+
+        if(count > rank) {
+            return std::min<double>(bucket + 1, max);
+        }
+    }
+
+    return max;
+}
+
+InputLatency::Summary InputLatency::summary() const {
+    Summary summary;
+    summary.keys = keys;
+    summary.withoutResponse = withoutResponse;
+    summary.median = percentile(0.5);
+    summary.percentile90 = percentile(0.9);
+    summary.percentile99 = percentile(0.99);
+    summary.max = max;
+
+    return summary;
+}
+
+void InputLatency::print(std::ostream& out) const {
+    Summary latency = summary();
+    out << "Input latency over " << latency.keys << " keys: median " << latency.median
+        << " ms, 90th percentile " << latency.percentile90 << " ms, 99th " << latency.percentile99
+        << " ms, max " << latency.max << " ms, " << latency.withoutResponse
+        << " keys without response" << std::endl;
+
+    if(keys == 0) {
+        return;
+    }
+
+    unsigned int first = 0;
+    while(buckets[first] == 0) {
+        ++first;
+    }
+
+    unsigned int last = BUCKETS - 1;
+    while(buckets[last] == 0) {
+        --last;
+    }
+
+    uint64_t highest = *std::max_element(buckets, buckets + BUCKETS);
+
+    for(unsigned int bucket = first; bucket <= last; ++bucket) {
+        unsigned int width = static_cast<unsigned int>((buckets[bucket] * BAR_WIDTH + highest - 1) / highest);
+
+        out << std::setw(4) << bucket << (bucket == BUCKETS - 1 ? "+ ms " : "  ms ")
+            << std::string(width, '#') << std::string(BAR_WIDTH - width, ' ') << " "
+            << buckets[bucket] << std::endl;
+    }
+}
@@ -0,0 +1,73 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#ifndef inputLatency_hpp
+#define inputLatency_hpp
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+/// Histogram of the time from a key pressed to the first presented frame
+/// that depends on it, i.e. the first one to change the display after the
+/// key reached the CPU. A frontend reports the keys with the time they
+/// arrived at, as stamped by the system, and each frame it presents.
+///
+/// A ROM drawing on every frame answers any key on the next one, so the
+/// latency of such a ROM is a lower bound. A key that changed nothing for
+/// RESPONSE_TIMEOUT counts as without response rather than as slow.
+class InputLatency {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    // One bucket per millisecond, the last one also holds the slower keys
+    static const unsigned int BUCKETS = 100;
+    static const unsigned int RESPONSE_TIMEOUT = 500; // ms
+
+    /// In milliseconds. A percentile is the upper edge of its bucket.
+    struct Summary {
+        uint64_t keys;
+        uint64_t withoutResponse;
+        double median;
+        double percentile90;
+        double percentile99;
+        double max;
+    };
+
+private:
+    struct Pending {
+        Clock::time_point arrival;
+        uint64_t generation;
+    };
+
+    // Keys not answered yet, oldest first
+    std::vector<Pending> pending;
+
+    uint64_t buckets[BUCKETS] = {};
+    uint64_t keys = 0;
+    uint64_t withoutResponse = 0;
+    double max = 0;
+
+    double percentile(double share) const;
+
+public:
+    /// A key went down at `arrival`, while the display presented was of
+    /// Framebuffer::generation `generation`
+    void keyPressed(Clock::time_point arrival, uint64_t generation);
+
+    /// A frame of `generation` was presented at `time`
+    void presented(Clock::time_point time, uint64_t generation);
+
+    Summary summary() const;
+
+    /// The summary, then a bar per bucket from the fastest key to the
+    /// slowest
+    void print(std::ostream& out) const;
+};
+
+#endif /* inputLatency_hpp */
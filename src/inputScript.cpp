@@ -0,0 +1,147 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include "inputScript.hpp"
+
+InputScript::InputScript(std::vector<InputEvent> events): events(std::move(events)) {
+    std::stable_sort(this->events.begin(), this->events.end(),
+                     [](const InputEvent& a, const InputEvent& b) {
+                         return a.frame < b.frame;
+                     });
+}
+
+InputScript InputScript::load(const char* filename) {
+    std::ifstream file(filename);
+
+    if(!file.is_open()) {
+        throw std::runtime_error(std::string("Input script doesn't exist: ") + filename);
+    }
+
+    std::vector<InputEvent> events;
+    std::string line;
+    unsigned int lineNumber = 0;
+
+    bool seeded = false;
+    uint64_t seed = 0;
+
+    while(std::getline(file, line)) {
+        ++lineNumber;
+
+        std::istringstream stream(line);
+        std::string first;
+
+        if(!(stream >> first) || first[0] == '#') {
+            continue;
+        }
+
+        if(first == "seed") {
+            if(!(stream >> std::hex >> seed)) {
+                throw std::runtime_error(std::string(filename) + ":" + std::to_string(lineNumber)
+                                         + ": expected \"seed value\"");
+            }
+
+            seeded = true;
+            continue;
+        }
+
+        unsigned long frame;
+        unsigned int key;
+        std::string state;
+
+        try {
+            frame = std::stoul(first);
+        } catch(const std::exception&) {
+            frame = ~0ul;
+        }
+
+        stream >> std::hex >> key >> state;
+
+        if(frame > UINT32_MAX || !stream || key > 0xF || (state != "down" && state != "up")) {
+            throw std::runtime_error(std::string(filename) + ":" + std::to_string(lineNumber)
+                                     + ": expected \"frame key down|up\"");
+        }
+
+        InputEvent event;
+        event.frame = static_cast<uint32_t>(frame);
+        event.key = static_cast<uint8_t>(key);
+        event.pressed = state == "down";
+
+        events.push_back(event);
+    }
+
+    InputScript inputScript(std::move(events));
+    inputScript.seeded = seeded;
+    inputScript.seed = seed;
+
+    return inputScript;
+}
+
+void InputScript::save(const char* filename) const {
+    std::ofstream file(filename);
+
+    if(seeded) {
+        file << "seed " << std::hex << std::uppercase << seed << std::dec << "\n";
+    }
+
+    for(const InputEvent& event: events) {
+        file << event.frame << " " << std::hex << std::uppercase << unsigned(event.key)
+             << std::dec << (event.pressed ? " down" : " up") << "\n";
+    }
+
+    if(!file) {
+        throw std::runtime_error(std::string("Cannot write input script: ") + filename);
+    }
+}
+
+void InputScript::apply(uint32_t frame, uint8_t* keyboard) {
+    while(next < events.size() && events[next].frame <= frame) {
+        keyboard[events[next].key] = events[next].pressed;
+        ++next;
+    }
+}
+
+void InputScript::rewind() {
+    next = 0;
+}
+
+void InputScript::record(uint32_t frame, const uint8_t* keyboard) {
+    for(uint8_t key = 0; key < 16; ++key) {
+        uint8_t pressed = keyboard[key] != 0;
+
+        if(pressed != recorded[key]) {
+            events.push_back({ frame, key, pressed });
+            recorded[key] = pressed;
+        }
+    }
+}
+
+bool InputScript::hasSeed() const {
+    return seeded;
+}
+
+uint64_t InputScript::getSeed() const {
+    return seed;
+}
+
+void InputScript::setSeed(uint64_t seed) {
+    this->seed = seed;
+    seeded = true;
+}
+
+uint32_t InputScript::lastFrame() const {
+    return events.empty() ? 0 : events.back().frame;
+}
+
+const std::vector<InputEvent>& InputScript::getEvents() const {
+    return events;
+}
@@ -0,0 +1,74 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#ifndef inputScript_hpp
+#define inputScript_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// A key of the CHIP-8 keyboard pressed or released at the start of a frame
+struct InputEvent {
+    uint32_t frame;
+    uint8_t key;
+    uint8_t pressed;
+};
+
+/// Input of a run, played back frame by frame, or recorded from a player.
+///
+/// The text format has one event per line, "frame key down|up", where key
+/// is a hexadecimal digit. An optional "seed value" line gives the seed of
+/// the random generator in hexadecimal. Empty lines and lines starting
+/// with # are ignored, e.g.
+///
+///     # Start the game, then move up for a second
+///     seed 2A
+///     10 5 down
+///     12 5 up
+///     60 1 down
+///     120 1 up
+class InputScript {
+private:
+    std::vector<InputEvent> events;
+    size_t next = 0;
+
+    bool seeded = false;
+    uint64_t seed = 0;
+
+    // Keyboard as of the last recorded frame
+    uint8_t recorded[16] = {};
+
+public:
+    InputScript() = default;
+    InputScript(std::vector<InputEvent> events);
+
+    /// Throws std::runtime_error when the file can not be read or parsed
+    static InputScript load(const char* filename);
+
+    /// Throws std::runtime_error when the file can not be written
+    void save(const char* filename) const;
+
+    /// Apply to the keyboard the events of the frames up to `frame`
+    void apply(uint32_t frame, uint8_t* keyboard);
+    void rewind();
+
+    /// Append an event for every key that changed since the last recorded
+    /// frame. Frames must be recorded in increasing order.
+    void record(uint32_t frame, const uint8_t* keyboard);
+
+    bool hasSeed() const;
+    uint64_t getSeed() const;
+    void setSeed(uint64_t seed);
+
+    /// Frame of the last event, 0 without events
+    uint32_t lastFrame() const;
+
+    const std::vector<InputEvent>& getEvents() const;
+};
+
+#endif /* inputScript_hpp */
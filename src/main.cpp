@@ -5,13 +5,27 @@
 //  Copyright © 2020 Cosme Jordan. All rights reserved.
 //
 
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <memory>
+#include <stdexcept>
 
 #include "cpu.hpp"
+#include "framePacer.hpp"
+#include "inputScript.hpp"
+#include "rewindBuffer.hpp"
+#include "romCatalog.hpp"
+#include "romImage.hpp"
 #include "screenView.hpp"
+#include "sound.hpp"
 
-const unsigned int VIDEO_HEIGHT = 32;
-const unsigned int VIDEO_WIDTH = 64;
+const unsigned int VIDEO_HEIGHT = Framebuffer::HEIGHT;
+const unsigned int VIDEO_WIDTH = Framebuffer::WIDTH;
+
+// Timers of the CHIP-8 tick at 60 Hz, the emulator runs one frame per tick
+const std::chrono::nanoseconds FRAME_PERIOD(1000000000 / 60);
 
 /// Keyboard is mapped as followed
 /// Original Chip8 keyboard -> Chip8 Emulator Keyboard
@@ -22,6 +36,32 @@ const unsigned int VIDEO_WIDTH = 64;
 /// | A, 0, B, F | -> | Z, X, C, V |
 ///
 /// Consider finding a better keyboard
+///
+/// Keys are matched by their position, so the layout is the same on any
+/// keyboard. A ROM of the catalog (see below) with a keymap uses it
+/// instead, and CHIP8_KEYMAP overrides both, e.g. "x123qweasdzc4rfv" for
+/// the keys 0 to F. The latency from each key pressed to the first frame
+/// it changed is printed as a histogram on exit.
+///
+/// Hold Backspace to rewind the game, one frame per frame
+///
+/// --record saves the seed and the keys of the session to an input script
+/// when the emulator quits. --replay feeds such a script back as fast as
+/// possible, then hands the keyboard over to the player at its last event.
+///
+/// With CHIP8_TRACE set to a path, every executed instruction is traced to
+/// that file, to be read with chip8-trace.
+///
+/// With CHIP8_CATALOG set to a ROM catalog (see chip8-catalog) that has the
+/// ROM, its title names the window and an InstructionsPerFrame of 0 takes
+/// the one tuned for it. The ROM runs with the quirks the catalog gives.
+///
+/// CHIP8_PALETTE replaces the colors of the display, e.g. "000000,33ff66",
+/// and CHIP8_PERSISTENCE, out of 256, makes switched off pixels fade out
+/// over a few frames to hide the flicker of sprites, e.g. 160.
+///
+/// With CHIP8_FRAME_RING set to a name, e.g. /chip8, every frame is
+/// published to a shared memory ring of that name, see FrameRing.
 
 void checkExtension(char const* filename) {
     std::string temp(filename);
@@ -38,21 +78,62 @@ void checkExtension(char const* filename) {
 }
 
 int main(int argc, char* argv[]) {
-    if (argc != 4) {
+    bool recording = argc == 6 && !strcmp(argv[4], "--record");
+    bool replaying = argc == 6 && !strcmp(argv[4], "--replay");
+
+    if (argc != 4 && !recording && !replaying) {
         std::cerr << "Usage: "
                   << argv[0]
-                  << " ScaleNumber DelayNumber PathToROM"
+                  << " ScaleNumber InstructionsPerFrame PathToROM"
+                  << " [--record|--replay PathToInputScript]"
                   << std::endl;
         std::exit(EXIT_FAILURE);
     }
 
     int videoScale = std::stoi(argv[1]);
-    int cycleDelay = std::stoi(argv[2]);
+    int instructionsPerFrame = std::stoi(argv[2]);
     char const* romFilename = argv[3];
+    char const* inputScriptFilename = argc == 6 ? argv[5] : nullptr;
+
+    InputScript inputScript;
+    if(replaying) {
+        inputScript = InputScript::load(inputScriptFilename);
+    } else {
+        inputScript.setSeed(std::chrono::system_clock::now().time_since_epoch().count());
+    }
 
     checkExtension(romFilename);
+
+    std::unique_ptr<RomImage> rom;
+    std::unique_ptr<RomCatalog> catalog;
+    const RomCatalog::Entry* entry = nullptr;
+
+    uint32_t palette[1u << Framebuffer::PLANES];
+    std::copy(Framebuffer::PALETTE, Framebuffer::PALETTE + (1u << Framebuffer::PLANES), palette);
+    const char* persistence = std::getenv("CHIP8_PERSISTENCE");
+
+    try {
+        rom.reset(new RomImage(romFilename));
+
+        if(const char* colors = std::getenv("CHIP8_PALETTE")) {
+            Presenter::parsePalette(colors, palette);
+        }
+
+        if(const char* catalogFilename = std::getenv("CHIP8_CATALOG")) {
+            catalog.reset(new RomCatalog(catalogFilename, false));
+            entry = catalog->find(rom->hash());
+        }
+    } catch(const std::exception& exception) {
+        std::cerr << "Error: " << exception.what() << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+
+    if(entry && entry->info.instructionsPerFrame && instructionsPerFrame == 0) {
+        instructionsPerFrame = entry->info.instructionsPerFrame;
+    }
     SDLWindowSpecification sdlWindowSpecification;
-    sdlWindowSpecification.screenTitle = "Chip-8 Emulator";
+    sdlWindowSpecification.screenTitle = entry && entry->info.title[0]
+                                         ? entry->info.title : "Chip-8 Emulator";
     sdlWindowSpecification.width = VIDEO_WIDTH * videoScale;
     sdlWindowSpecification.height = VIDEO_HEIGHT * videoScale;
     sdlWindowSpecification.textureWidth = VIDEO_WIDTH;
@@ -60,29 +141,118 @@ int main(int argc, char* argv[]) {
 
     ScreenView screenView(sdlWindowSpecification);
     screenView.initSDL();
+    screenView.getPresenter().setPalette(palette);
+    screenView.getPresenter().setPersistence(persistence ? std::atoi(persistence) : 0);
+
+    try {
+        const char* keymap = std::getenv("CHIP8_KEYMAP");
+
+        if(keymap && strlen(keymap) != RomInfo::KEYMAP_SIZE) {
+            throw std::runtime_error(std::string("Keymap ") + keymap + " doesn't have 16 keys");
+        } else if(keymap) {
+            screenView.setKeymap(keymap);
+        } else if(entry) {
+            screenView.setKeymap(entry->info.keymap);
+        }
+    } catch(const std::exception& exception) {
+        std::cerr << "Error: " << exception.what() << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+
+    SimpleSound simpleSound;
 
     CPU* chip8 = new CPU();
-    chip8->loadROM(romFilename);
-    
-    int pitch = sizeof(chip8->screen[0]) * VIDEO_WIDTH;
+    chip8->setSoundSink(replaying ? nullptr : &simpleSound);
+    chip8->setDisplaySink(&screenView);
+    chip8->loadROM(rom->data(), rom->size());
+    chip8->setQuirks(entry ? entry->info.quirks : Quirks::MODERN);
+    chip8->seedRandom(inputScript.hasSeed() ? inputScript.getSeed() : CPU::DEFAULT_SEED);
+
+    std::unique_ptr<FrameRing> frameRing;
+    if(const char* frameRingName = std::getenv("CHIP8_FRAME_RING")) {
+        try {
+            frameRing.reset(new FrameRing(frameRingName));
+        } catch(const std::exception& exception) {
+            std::cerr << "Error: " << exception.what() << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+        chip8->setFrameRing(frameRing.get());
+    }
+
+    std::unique_ptr<TraceRing> traceRing;
+    if(const char* traceFilename = std::getenv("CHIP8_TRACE")) {
+        traceRing.reset(new TraceRing());
+        traceRing->startFlushing(traceFilename);
+        chip8->setTrace(traceRing.get());
+    }
     
-    auto lastCycleTime = std::chrono::high_resolution_clock::now();
+    FramePacer framePacer(FRAME_PERIOD);
+    RewindBuffer rewindBuffer;
     bool quit = false;
+    uint32_t frame = 0;
 
     while (!quit) {
+        // While replaying, the script owns the keyboard and frames are
+        // neither presented, paced nor heard
+        if(replaying && frame <= inputScript.lastFrame()) {
+            uint8_t ignored[16] = {};
+            quit = screenView.inputKeys(ignored);
+
+            inputScript.apply(frame++, chip8->keyboard);
+            chip8->runFrame(instructionsPerFrame);
+            rewindBuffer.record(*chip8);
+
+            if(frame > inputScript.lastFrame()) {
+                chip8->setSoundSink(&simpleSound);
+            }
+
+            continue;
+        }
+
         quit = screenView.inputKeys(chip8->keyboard);
-        
-        auto currentTime = std::chrono::high_resolution_clock::now();
-        float dt = std::chrono::duration<float, std::chrono::milliseconds::period>(currentTime - lastCycleTime).count();
 
-        if (dt > cycleDelay) {
-            lastCycleTime = currentTime;
+        // The recorded script could not follow the game back in time
+        if(!recording && screenView.isRewinding()) {
+            // The keys held now are the ones of the player, not of the past
+            uint8_t keyboard[16];
+            std::copy(chip8->keyboard, chip8->keyboard + 16, keyboard);
+            rewindBuffer.rewind(*chip8);
+            std::copy(keyboard, keyboard + 16, chip8->keyboard);
+        } else {
+            if(recording) {
+                inputScript.record(frame, chip8->keyboard);
+            }
 
-            chip8->runCycle();
-            screenView.draw(chip8->screen, pitch);
+            ++frame;
+            chip8->runFrame(instructionsPerFrame);
+            rewindBuffer.record(*chip8);
         }
+
+        chip8->present();
+
+        framePacer.waitNextFrame();
     }
+
+    FramePacer::Jitter jitter = framePacer.jitter();
+    std::cout << "Frame jitter over " << jitter.frames << " frames: mean "
+              << jitter.mean << " us, standard deviation " << jitter.standardDeviation
+              << " us, max " << jitter.max << " us, " << jitter.droppedFrames
+              << " dropped frames" << std::endl;
+
+    screenView.getInputLatency().print(std::cout);
  
+    if(recording) {
+        inputScript.save(inputScriptFilename);
+    }
+
+#ifdef CHIP8_PROFILE
+    chip8->profile.dump();
+#endif
+
+    if(traceRing) {
+        traceRing->stopFlushing();
+    }
+
     screenView.destorySDL();
     delete chip8;
 
@@ -0,0 +1,117 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#ifndef opcodeFamily_hpp
+#define opcodeFamily_hpp
+
+#include <cstdint>
+
+/// Instructions grouped by handler, whatever their operands
+
+enum class Family: uint8_t {
+    NOPE, CLS, RET, JP, CALL, SE_KK, SNE_KK, SE_XY, LD_KK, ADD_KK,
+    LD_XY, OR, AND, XOR, ADD_XY, SUB, SHR, SUBN, SHL, SNE_XY,
+    LD_I, JP_V0, RND, DRW, SKP, SKNP, LD_VX_DT, LD_VX_K, LD_DT, LD_ST,
+    ADD_I, LD_F, LD_B, LD_MEM_VX, LD_VX_MEM,
+
+    // SUPER-CHIP and XO-CHIP
+    SCD, SCU, SCR, SCL, EXIT, LOW, HIGH, SAVE_XY, LOAD_XY, PLANE,
+    LD_HF, LD_R_VX, LD_VX_R
+};
+
+static const unsigned int FAMILY_COUNT = static_cast<unsigned int>(Family::LD_VX_R) + 1;
+
+/// Family of an opcode, decoded exactly like the opcode tables of cpu.cpp:
+/// unknown opcodes the tables ignore are NOPE
+constexpr Family family(uint16_t opcode) {
+    unsigned int n = opcode & 0x000Fu;
+    unsigned int kk = opcode & 0x00FFu;
+
+    switch(opcode >> 12) {
+        case 0x0:
+            switch(kk & 0xF0) {
+                case 0xC0: return Family::SCD;
+                case 0xD0: return Family::SCU;
+            }
+            switch(kk) {
+                case 0xE0: return Family::CLS;
+                case 0xEE: return Family::RET;
+                case 0xFB: return Family::SCR;
+                case 0xFC: return Family::SCL;
+                case 0xFD: return Family::EXIT;
+                case 0xFE: return Family::LOW;
+                case 0xFF: return Family::HIGH;
+                default: return Family::NOPE;
+            }
+        case 0x1: return Family::JP;
+        case 0x2: return Family::CALL;
+        case 0x3: return Family::SE_KK;
+        case 0x4: return Family::SNE_KK;
+        case 0x5:
+            switch(n) {
+                case 0x0: return Family::SE_XY;
+                case 0x2: return Family::SAVE_XY;
+                case 0x3: return Family::LOAD_XY;
+                default: return Family::NOPE;
+            }
+        case 0x6: return Family::LD_KK;
+        case 0x7: return Family::ADD_KK;
+        case 0x8:
+            switch(n) {
+                case 0x0: return Family::LD_XY;
+                case 0x1: return Family::OR;
+                case 0x2: return Family::AND;
+                case 0x3: return Family::XOR;
+                case 0x4: return Family::ADD_XY;
+                case 0x5: return Family::SUB;
+                case 0x6: return Family::SHR;
+                case 0x7: return Family::SUBN;
+                case 0xE: return Family::SHL;
+                default: return Family::NOPE;
+            }
+        case 0x9: return Family::SNE_XY;
+        case 0xA: return Family::LD_I;
+        case 0xB: return Family::JP_V0;
+        case 0xC: return Family::RND;
+        case 0xD: return Family::DRW;
+        case 0xE:
+            return n == 0xE ? Family::SKP : n == 0x1 ? Family::SKNP : Family::NOPE;
+        default:
+            switch(kk) {
+                case 0x01: return Family::PLANE;
+                case 0x07: return Family::LD_VX_DT;
+                case 0x0A: return Family::LD_VX_K;
+                case 0x15: return Family::LD_DT;
+                case 0x18: return Family::LD_ST;
+                case 0x1E: return Family::ADD_I;
+                case 0x29: return Family::LD_F;
+                case 0x30: return Family::LD_HF;
+                case 0x33: return Family::LD_B;
+                case 0x55: return Family::LD_MEM_VX;
+                case 0x65: return Family::LD_VX_MEM;
+                case 0x75: return Family::LD_R_VX;
+                case 0x85: return Family::LD_VX_R;
+                default: return Family::NOPE;
+            }
+    }
+}
+
+/// Pattern of the opcodes of a family, e.g. "Dxyn"
+inline const char* familyName(Family family) {
+    static const char* const NAMES[FAMILY_COUNT] = {
+        "unknown", "00E0", "00EE", "1nnn", "2nnn", "3xkk", "4xkk", "5xy0", "6xkk", "7xkk",
+        "8xy0", "8xy1", "8xy2", "8xy3", "8xy4", "8xy5", "8xy6", "8xy7", "8xyE", "9xy0",
+        "Annn", "Bnnn", "Cxkk", "Dxyn", "Ex9E", "ExA1", "Fx07", "Fx0A", "Fx15", "Fx18",
+        "Fx1E", "Fx29", "Fx33", "Fx55", "Fx65",
+        "00Cn", "00Dn", "00FB", "00FC", "00FD", "00FE", "00FF", "5xy2", "5xy3", "Fn01",
+        "Fx30", "Fx75", "Fx85",
+    };
+
+    return NAMES[static_cast<unsigned int>(family)];
+}
+
+#endif /* opcodeFamily_hpp */
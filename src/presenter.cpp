@@ -0,0 +1,339 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "presenter.hpp"
+
+// SSE2 is part of x86-64. AVX2 is compiled for its own functions only, and
+// picked at runtime when the CPU has it.
+#if defined(__SSE2__)
+#define HAS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define HAS_AVX2 1
+#include <immintrin.h>
+#endif
+
+static const unsigned int WORDS = Framebuffer::WORDS;
+static const unsigned int COLORS = 1u << Framebuffer::PLANES;
+
+// ===========================================================================
+// ===========================================================================
+// ===========================================================================
+// Kernels
+
+/// A row of the display, `words` 64-bit words in each plane. The most
+/// significant bit is the leftmost pixel.
+struct Row {
+    uint64_t first[WORDS];
+    uint64_t second[WORDS];
+    unsigned int words;
+};
+
+// With FADE, the kernels blend each color with the pixel already in `out`:
+// every channel of the pixel is scaled by persistence / 256, and the
+// brighter of it and the channel of the color is kept.
+
+static inline uint32_t fadeScalar(uint32_t color, uint32_t previous, unsigned int persistence) {
+    uint32_t pixel = 0;
+
+    for(unsigned int shift = 0; shift < 32; shift += 8) {
+        uint32_t faded = (((previous >> shift) & 0xFFu) * persistence) >> 8;
+        pixel |= std::max(faded, (color >> shift) & 0xFFu) << shift;
+    }
+
+    return pixel;
+}
+
+template<bool FADE>
+static void expandScalar(const Row& row, const uint32_t* palette, unsigned int persistence,
+                         uint32_t* out) {
+    for(unsigned int word = 0; word < row.words; ++word) {
+        for(unsigned int i = 0; i < 64; ++i) {
+            unsigned int index = ((row.first[word] >> (63 - i)) & 0x1u)
+                | (((row.second[word] >> (63 - i)) & 0x1u) << 1);
+            uint32_t& pixel = out[64 * word + i];
+
+            pixel = FADE ? fadeScalar(palette[index], pixel, persistence) : palette[index];
+        }
+    }
+}
+
+#if HAS_SSE2
+static inline __m128i fadeSSE2(__m128i colors, __m128i previous, __m128i weight) {
+    const __m128i zero = _mm_setzero_si128();
+
+    // Channels widened to 16 bits for the product
+    __m128i low = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(previous, zero), weight), 8);
+    __m128i high = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(previous, zero), weight), 8);
+
+    return _mm_max_epu8(colors, _mm_packus_epi16(low, high));
+}
+
+/// 4 pixels per step, copied from the colors of the nibble of each plane
+template<bool FADE>
+static void expandSSE2(const Row& row, const uint32_t (*quads)[4], unsigned int persistence,
+                       uint32_t* out) {
+    const __m128i weight = _mm_set1_epi16(static_cast<short>(persistence));
+
+    for(unsigned int word = 0; word < row.words; ++word) {
+        for(unsigned int i = 0; i < 16; ++i) {
+            unsigned int shift = 60 - 4 * i;
+            unsigned int quad = ((row.first[word] >> shift) & 0xF) | (((row.second[word] >> shift) & 0xF) << 4);
+            __m128i* pixels = reinterpret_cast<__m128i*>(out + 64 * word + 4 * i);
+
+            __m128i colors = _mm_load_si128(reinterpret_cast<const __m128i*>(quads[quad]));
+            if(FADE) {
+                colors = fadeSSE2(colors, _mm_loadu_si128(pixels), weight);
+            }
+
+            _mm_storeu_si128(pixels, colors);
+        }
+    }
+}
+#endif
+
+#if HAS_AVX2
+__attribute__((target("avx2")))
+static inline __m256i fadeAVX2(__m256i colors, __m256i previous, __m256i weight) {
+    const __m256i zero = _mm256_setzero_si256();
+
+    // Unpacking and packing both stay within 128-bit lanes, so the
+    // channels end where they started
+    __m256i low = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(previous, zero), weight), 8);
+    __m256i high = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(previous, zero), weight), 8);
+
+    return _mm256_max_epu8(colors, _mm256_packus_epi16(low, high));
+}
+
+/// 8 pixels per step: each lane shifts its bit of a byte of each plane
+/// into a color index, and picks the color from the palette in a register
+template<bool FADE>
+__attribute__((target("avx2")))
+static void expandAVX2(const Row& row, const uint32_t* palette, unsigned int persistence,
+                       uint32_t* out) {
+    const __m256i SHIFTS = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+    const __m256i FIRST = _mm256_set1_epi32(0x1);
+    const __m256i SECOND = _mm256_set1_epi32(0x2);
+    const __m256i weight = _mm256_set1_epi16(static_cast<short>(persistence));
+    __m256i colors = _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(palette)));
+
+    for(unsigned int word = 0; word < row.words; ++word) {
+        for(unsigned int i = 0; i < 8; ++i) {
+            unsigned int shift = 56 - 8 * i;
+            // The byte of the second plane 9 bits up, to land on bit 1
+            unsigned int bytes = ((row.first[word] >> shift) & 0xFF) | (((row.second[word] >> shift) & 0xFF) << 9);
+            __m256i* pixels = reinterpret_cast<__m256i*>(out + 64 * word + 8 * i);
+
+            __m256i shifted = _mm256_srlv_epi32(_mm256_set1_epi32(bytes), SHIFTS);
+            __m256i indices = _mm256_or_si256(_mm256_and_si256(shifted, FIRST),
+                                              _mm256_and_si256(_mm256_srli_epi32(shifted, 8), SECOND));
+
+            __m256i expanded = _mm256_permutevar8x32_epi32(colors, indices);
+            if(FADE) {
+                expanded = fadeAVX2(expanded, _mm256_loadu_si256(pixels), weight);
+            }
+
+            _mm256_storeu_si256(pixels, expanded);
+        }
+    }
+}
+#endif
+
+template<bool FADE>
+static void expandRow(Presenter::Kernel kernel, const Row& row, const uint32_t* palette,
+                      const uint32_t (*quads)[4], unsigned int persistence, uint32_t* out) {
+    switch(kernel) {
+#if HAS_AVX2
+        case Presenter::Kernel::AVX2:
+            expandAVX2<FADE>(row, palette, persistence, out);
+            break;
+#endif
+#if HAS_SSE2
+        case Presenter::Kernel::SSE2:
+            expandSSE2<FADE>(row, quads, persistence, out);
+            break;
+#endif
+        default:
+            expandScalar<FADE>(row, palette, persistence, out);
+    }
+}
+
+// ===========================================================================
+// ===========================================================================
+// ===========================================================================
+// Presenter
+
+Presenter::Kernel Presenter::bestKernel() {
+#if HAS_AVX2
+    if(__builtin_cpu_supports("avx2")) {
+        return Kernel::AVX2;
+    }
+#endif
+
+#if HAS_SSE2
+    return Kernel::SSE2;
+#else
+    return Kernel::Scalar;
+#endif
+}
+
+void Presenter::parsePalette(const char* text, uint32_t* palette) {
+    std::string colors(text);
+    size_t begin = 0;
+
+    for(unsigned int i = 0; i <= COLORS; ++i) {
+        size_t end = std::min(colors.find(',', begin), colors.size());
+        std::string color = colors.substr(begin, end - begin);
+
+        if(i == COLORS || (color.size() != 6 && color.size() != 8)
+           || color.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos) {
+            throw std::runtime_error("Invalid palette " + colors
+                                     + ": expected up to 4 colors RRGGBB or RRGGBBAA");
+        }
+
+        uint32_t value = static_cast<uint32_t>(std::stoul(color, nullptr, 16));
+        palette[i] = color.size() == 6 ? (value << 8) | 0xFF : value;
+
+        if(end == colors.size()) {
+            return;
+        }
+
+        begin = end + 1;
+    }
+}
+
+Presenter::Presenter() {
+    setPalette(Framebuffer::PALETTE);
+}
+
+bool Presenter::setKernel(Kernel kernel) {
+    bool supported = kernel == Kernel::Scalar;
+
+#if HAS_SSE2
+    supported = supported || kernel == Kernel::SSE2;
+#endif
+#if HAS_AVX2
+    supported = supported || (kernel == Kernel::AVX2 && __builtin_cpu_supports("avx2"));
+#endif
+
+    if(supported) {
+        this->kernel = kernel;
+        invalidate();
+    }
+
+    return supported;
+}
+
+Presenter::Kernel Presenter::getKernel() const {
+    return kernel;
+}
+
+void Presenter::setPalette(const uint32_t* palette) {
+    std::copy(palette, palette + COLORS, this->palette);
+
+    for(unsigned int quad = 0; quad < 0x100; ++quad) {
+        for(unsigned int i = 0; i < 4; ++i) {
+            quads[quad][i] = palette[((quad >> (3 - i)) & 0x1u) | (((quad >> (7 - i)) & 0x1u) << 1)];
+        }
+    }
+    invalidate();
+}
+
+void Presenter::setPersistence(unsigned int persistence) {
+    this->persistence = std::min(persistence, 255u);
+
+    // A channel strictly decreases until 0, however close to 256 the share
+    fadeFrames = 0;
+    unsigned int channel = this->persistence > 0 ? 0xFF : 0;
+    while(channel > 0) {
+        channel = (channel * this->persistence) >> 8;
+        ++fadeFrames;
+    }
+
+    invalidate();
+}
+
+bool Presenter::present(const Framebuffer& framebuffer, unsigned int& begin, unsigned int& end) {
+    // The ROM switched between low and high resolution
+    if(framebuffer.width() != width || framebuffer.height() != height) {
+        width = framebuffer.width();
+        height = framebuffer.height();
+        pixels.assign(width * height, palette[0]);
+        fadingFrames = 0;
+        fullRedraw = true;
+    }
+
+    bool changed = true;
+    if(fullRedraw) {
+        begin = 0;
+        end = height;
+    } else {
+        changed = framebuffer.dirtyRows(presentedGeneration, begin, end);
+    }
+
+    fullRedraw = false;
+    presentedGeneration = framebuffer.generation;
+
+    // Rows changed now fade from this frame on, along with those still
+    // fading from before
+    if(persistence > 0 && (changed || fadingFrames > 0)) {
+        if(changed && fadingFrames > 0) {
+            fadingBegin = std::min(fadingBegin, begin);
+            fadingEnd = std::max(fadingEnd, end);
+        } else if(changed) {
+            fadingBegin = begin;
+            fadingEnd = end;
+        }
+
+        fadingFrames = changed ? fadeFrames : fadingFrames - 1;
+        begin = fadingBegin;
+        end = fadingEnd;
+    } else if(!changed) {
+        return false;
+    }
+
+    Row row;
+    row.words = framebuffer.isHires() ? WORDS : 1;
+
+    for(unsigned int y = begin; y < end; ++y) {
+        for(unsigned int word = 0; word < row.words; ++word) {
+            row.first[word] = framebuffer.bits[0][word][y];
+            row.second[word] = framebuffer.bits[1][word][y];
+        }
+
+        if(persistence > 0) {
+            expandRow<true>(kernel, row, palette, quads, persistence, &pixels[y * width]);
+        } else {
+            expandRow<false>(kernel, row, palette, quads, persistence, &pixels[y * width]);
+        }
+    }
+
+    return true;
+}
+
+void Presenter::invalidate() {
+    fullRedraw = true;
+}
+
+unsigned int Presenter::getWidth() const {
+    return width;
+}
+
+unsigned int Presenter::getHeight() const {
+    return height;
+}
+
+const uint32_t* Presenter::getPixels() const {
+    return pixels.data();
+}
@@ -0,0 +1,99 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#ifndef presenter_hpp
+#define presenter_hpp
+
+#include <cstdint>
+#include <vector>
+
+#include "framebuffer.hpp"
+
+/// Presentation stage between the framebuffer and a display: expands the
+/// bitplanes into RGBA pixels through a palette of 4 colors, with SSE2 or
+/// AVX2 when the CPU has them.
+///
+/// With persistence, a pixel switched off fades out over a few frames like
+/// the phosphor of a CRT instead of disappearing at once, which hides the
+/// flicker of ROMs that erase a sprite and draw it again one frame later.
+/// Every channel of the previous frame is scaled by persistence / 256 and
+/// the brighter of it and the new color is kept.
+class Presenter {
+public:
+    enum class Kernel {
+        Scalar,
+        SSE2,
+        AVX2
+    };
+
+    /// The fastest kernel the CPU supports
+    static Kernel bestKernel();
+
+    /// Parse a palette of up to 4 comma separated RRGGBB or RRGGBBAA colors,
+    /// e.g. "000000,33ff66", into the first colors of `palette`. Throws
+    /// std::runtime_error on anything else.
+    static void parsePalette(const char* text, uint32_t* palette);
+
+private:
+    Kernel kernel = bestKernel();
+
+    uint32_t palette[1u << Framebuffer::PLANES];
+
+    // Colors of 4 pixels, indexed by their bits in the first plane and 4
+    // bits up in the second one
+    alignas(16) uint32_t quads[0x100][4];
+
+    // Out of 256, 0 without persistence
+    unsigned int persistence = 0;
+    // Frames for the brightest channel to fade to the new color
+    unsigned int fadeFrames = 0;
+
+    // Rows still fading since their last change, and frames left
+    unsigned int fadingBegin = 0;
+    unsigned int fadingEnd = 0;
+    unsigned int fadingFrames = 0;
+
+    unsigned int width = 0;
+    unsigned int height = 0;
+
+    // Generation of the framebuffer presented, see Framebuffer::generation
+    uint64_t presentedGeneration = 0;
+    bool fullRedraw = true;
+
+    // width * height RGBA pixels, also the previous frame persistence
+    // fades from
+    std::vector<uint32_t> pixels;
+
+public:
+    Presenter();
+
+    /// Returns false when the CPU doesn't support the kernel
+    bool setKernel(Kernel kernel);
+    Kernel getKernel() const;
+
+    /// 4 colors, for off, first plane, second plane and both
+    void setPalette(const uint32_t* palette);
+
+    /// Share of the previous frame kept, out of 256. 0, the default,
+    /// disables persistence.
+    void setPersistence(unsigned int persistence);
+
+    /// Expand what changed since the last call, and the rows still fading.
+    /// Returns false when no pixel changed, otherwise the range [begin,
+    /// end) of the rows to present again.
+    bool present(const Framebuffer& framebuffer, unsigned int& begin, unsigned int& end);
+
+    /// Expand every row on the next call, e.g. when the window lost its
+    /// content
+    void invalidate();
+
+    unsigned int getWidth() const;
+    unsigned int getHeight() const;
+    const uint32_t* getPixels() const;
+};
+
+#endif /* presenter_hpp */
@@ -0,0 +1,106 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "profile.hpp"
+
+static std::string address(unsigned int address) {
+    char buffer[8];
+    std::snprintf(buffer, sizeof(buffer), "0x%03X", address);
+
+    return buffer;
+}
+
+static uint64_t familyCount(const Profile& profile, Family family) {
+    return profile.families[static_cast<unsigned int>(family)];
+}
+
+void Profile::merge(const Profile& profile) {
+    instructions += profile.instructions;
+    timerTicks += profile.timerTicks;
+    idleInstructions += profile.idleInstructions;
+
+    for(unsigned int i = 0; i < FAMILY_COUNT; ++i) {
+        families[i] += profile.families[i];
+    }
+
+    for(unsigned int i = 0; i < ADDRESSES; ++i) {
+        addresses[i] += profile.addresses[i];
+    }
+}
+
+/// One "section,key,count" line per counter. Addresses never executed are
+/// left out.
+void Profile::writeCSV(std::ostream& out) const {
+    out << "section,key,count\n"
+        << "total,instructions," << instructions << "\n"
+        << "event,draws," << familyCount(*this, Family::DRW) << "\n"
+        << "event,clears," << familyCount(*this, Family::CLS) << "\n"
+        << "event,timerTicks," << timerTicks << "\n"
+        << "event,idleInstructions," << idleInstructions << "\n";
+
+    for(unsigned int i = 0; i < FAMILY_COUNT; ++i) {
+        out << "family," << familyName(static_cast<Family>(i)) << "," << families[i] << "\n";
+    }
+
+    for(unsigned int i = 0; i < ADDRESSES; ++i) {
+        if(addresses[i]) {
+            out << "address," << address(i) << "," << addresses[i] << "\n";
+        }
+    }
+}
+
+void Profile::writeJSON(std::ostream& out) const {
+    out << "{\n"
+        << "  \"instructions\": " << instructions << ",\n"
+        << "  \"events\": { \"draws\": " << familyCount(*this, Family::DRW)
+        << ", \"clears\": " << familyCount(*this, Family::CLS)
+        << ", \"timerTicks\": " << timerTicks
+        << ", \"idleInstructions\": " << idleInstructions << " },\n"
+        << "  \"families\": {";
+
+    for(unsigned int i = 0; i < FAMILY_COUNT; ++i) {
+        out << (i ? ", " : " ") << "\"" << familyName(static_cast<Family>(i)) << "\": " << families[i];
+    }
+
+    out << " },\n"
+        << "  \"addresses\": {";
+
+    bool first = true;
+    for(unsigned int i = 0; i < ADDRESSES; ++i) {
+        if(addresses[i]) {
+            out << (first ? "\n    " : ",\n    ") << "\"" << address(i) << "\": " << addresses[i];
+            first = false;
+        }
+    }
+
+    out << "\n  }\n"
+        << "}\n";
+}
+
+void Profile::dump() const {
+    const char* filename = std::getenv("CHIP8_PROFILE_OUTPUT");
+    std::string name = filename ? filename : "chip8-profile.csv";
+
+    std::ofstream file(name);
+    if(name.size() >= 5 && name.compare(name.size() - 5, 5, ".json") == 0) {
+        writeJSON(file);
+    } else {
+        writeCSV(file);
+    }
+
+    if(!file) {
+        std::cerr << "Cannot write the profile to " << name << std::endl;
+    } else {
+        std::cerr << "Profile written to " << name << std::endl;
+    }
+}
@@ -0,0 +1,59 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#ifndef profile_hpp
+#define profile_hpp
+
+#include <cstdint>
+#include <ostream>
+
+#include "opcodeFamily.hpp"
+
+/// Execution counters of a CPU: instructions per opcode family, per
+/// address of the 4 KB space, and display, timer and idle events.
+///
+/// The CPU only keeps one, and only counts, when built with the
+/// CHIP8_PROFILE option. Otherwise the PROFILE_* macros expand to nothing.
+struct Profile {
+    static const unsigned int ADDRESSES = 0x1000;
+
+    uint64_t instructions = 0;
+    uint64_t families[FAMILY_COUNT] = {};
+    uint64_t addresses[ADDRESSES] = {};
+    uint64_t timerTicks = 0;
+
+    // Instructions of idle loops jumped over, not in the counts above
+    uint64_t idleInstructions = 0;
+
+    void count(uint16_t address, uint16_t opcode) {
+        ++instructions;
+        ++families[static_cast<unsigned int>(family(opcode))];
+        ++addresses[address & (ADDRESSES - 1)];
+    }
+
+    void merge(const Profile& profile);
+
+    void writeCSV(std::ostream& out) const;
+    void writeJSON(std::ostream& out) const;
+
+    /// Write to the file named by the CHIP8_PROFILE_OUTPUT environment
+    /// variable, chip8-profile.csv by default. A name ending in .json
+    /// selects JSON.
+    void dump() const;
+};
+
+#ifdef CHIP8_PROFILE
+#define PROFILE_INSTRUCTION(cpu, address, opcode) (cpu).profile.count(address, opcode)
+#define PROFILE_TIMER_TICK(cpu) (++(cpu).profile.timerTicks)
+#define PROFILE_IDLE(cpu, count) ((cpu).profile.idleInstructions += (count))
+#else
+#define PROFILE_INSTRUCTION(cpu, address, opcode) ((void)(cpu), (void)(address), (void)(opcode))
+#define PROFILE_TIMER_TICK(cpu) ((void)(cpu))
+#define PROFILE_IDLE(cpu, count) ((void)(cpu), (void)(count))
+#endif
+
+#endif /* profile_hpp */
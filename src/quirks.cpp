@@ -0,0 +1,49 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#include <cstdlib>
+#include <stdexcept>
+
+#include "quirks.hpp"
+
+static const struct {
+    const char* name;
+    uint32_t quirks;
+} PROFILES[] = {
+    { "modern", Quirks::MODERN },
+    { "vip", Quirks::COSMAC_VIP },
+    { "schip", Quirks::SUPER_CHIP },
+    { "xochip", Quirks::XO_CHIP },
+};
+
+uint32_t parseQuirks(const std::string& name) {
+    for(const auto& profile: PROFILES) {
+        if(name == profile.name) {
+            return profile.quirks;
+        }
+    }
+
+    char* end = nullptr;
+    unsigned long quirks = std::strtoul(name.c_str(), &end, 0);
+
+    if(name.empty() || *end != '\0' || quirksName(quirks) == nullptr) {
+        throw std::runtime_error("No quirk profile " + name
+                                 + ", expected modern, vip, schip, xochip or their bits");
+    }
+
+    return quirks;
+}
+
+const char* quirksName(uint32_t quirks) {
+    for(const auto& profile: PROFILES) {
+        if(quirks == profile.quirks) {
+            return profile.name;
+        }
+    }
+
+    return nullptr;
+}
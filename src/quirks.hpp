@@ -0,0 +1,62 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#ifndef quirks_hpp
+#define quirks_hpp
+
+#include <cstdint>
+#include <string>
+
+/// Behaviours the CHIP-8 interpreters disagree on, as bits. A ROM written
+/// for one interpreter can break on the others.
+struct Quirks {
+    // 8xy6 and 8xyE shift Vy into Vx, instead of shifting Vx
+    static const uint32_t SHIFT_VY = 0x01;
+    // Fx55 and Fx65 leave I past the last register
+    static const uint32_t INCREMENT_I = 0x02;
+    // Bnnn jumps to nnn + Vx, x being the first digit of nnn, not to nnn + V0
+    static const uint32_t JUMP_VX = 0x04;
+    // 8xy1, 8xy2 and 8xy3 set VF to 0
+    static const uint32_t RESET_VF = 0x08;
+    // Sprites wrap around the edges of the display instead of being clipped
+    static const uint32_t WRAP_SPRITES = 0x10;
+
+    // Profiles, each compiled to an interpreter of its own. MODERN is what
+    // this emulator always did.
+    static const uint32_t MODERN = 0;
+    static const uint32_t COSMAC_VIP = SHIFT_VY | INCREMENT_I | RESET_VF;
+    static const uint32_t SUPER_CHIP = JUMP_VX;
+    static const uint32_t XO_CHIP = SHIFT_VY | INCREMENT_I | WRAP_SPRITES;
+};
+
+/// Quirks as a policy: the handlers of the CPU are templates over it, so a
+/// quirk costs no branch once its profile is picked
+template<uint32_t QUIRKS>
+struct QuirkPolicy {
+    static const uint32_t BITS = QUIRKS;
+
+    static const bool SHIFT_VY = (QUIRKS & Quirks::SHIFT_VY) != 0;
+    static const bool INCREMENT_I = (QUIRKS & Quirks::INCREMENT_I) != 0;
+    static const bool JUMP_VX = (QUIRKS & Quirks::JUMP_VX) != 0;
+    static const bool RESET_VF = (QUIRKS & Quirks::RESET_VF) != 0;
+    static const bool WRAP_SPRITES = (QUIRKS & Quirks::WRAP_SPRITES) != 0;
+};
+
+typedef QuirkPolicy<Quirks::MODERN> ModernQuirks;
+typedef QuirkPolicy<Quirks::COSMAC_VIP> CosmacVipQuirks;
+typedef QuirkPolicy<Quirks::SUPER_CHIP> SuperChipQuirks;
+typedef QuirkPolicy<Quirks::XO_CHIP> XoChipQuirks;
+
+/// Quirks of a profile, "modern", "vip", "schip" or "xochip", or given as
+/// a number. Throws std::runtime_error when they are not one of the
+/// profiles.
+uint32_t parseQuirks(const std::string& name);
+
+/// Name of the profile of `quirks`, nullptr when they are not one
+const char* quirksName(uint32_t quirks);
+
+#endif /* quirks_hpp */
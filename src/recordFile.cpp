@@ -0,0 +1,138 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "recordFile.hpp"
+#include "systemError.hpp"
+
+RecordFile::RecordFile(const char* filename, bool writable, const char* kind, uint64_t magic,
+                       uint32_t version, size_t recordSize):
+    kind(kind), recordSize(recordSize), writable(writable) {
+    fd = open(filename, writable ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+
+    if(fd < 0) {
+        throw systemError("Cannot open " + this->kind + " " + filename);
+    }
+
+    struct stat status;
+    if(fstat(fd, &status) != 0) {
+        close(fd);
+        throw systemError("Cannot open " + this->kind + " " + filename);
+    }
+
+    size_t fileSize = status.st_size;
+
+    if(fileSize == 0 && writable) {
+        Header empty = { magic, version, static_cast<uint32_t>(recordSize), 0, 0 };
+
+        if(pwrite(fd, &empty, sizeof(empty), 0) != sizeof(empty)) {
+            close(fd);
+            throw systemError("Cannot write " + this->kind + " " + filename);
+        }
+
+        fileSize = sizeof(Header);
+    }
+
+    if(fileSize < sizeof(Header)) {
+        close(fd);
+        throw std::runtime_error("Not a " + this->kind + ": " + filename);
+    }
+
+    try {
+        map((fileSize - sizeof(Header)) / recordSize);
+    } catch(const std::runtime_error&) {
+        close(fd);
+        throw;
+    }
+
+    if(header().magic != magic || header().version != version
+       || header().recordSize != recordSize || header().count > capacity) {
+        munmap(mapping, mappingSize);
+        close(fd);
+        throw std::runtime_error("Incompatible " + this->kind + ": " + filename);
+    }
+}
+
+RecordFile::~RecordFile() {
+    size_t usedSize = sizeof(Header) + size() * recordSize;
+
+    munmap(mapping, mappingSize);
+
+    if(writable) {
+        // Give back the capacity reserved for the next records. On failure
+        // the file stays valid, with an unused tail.
+        int result = ftruncate(fd, usedSize);
+        (void) result;
+    }
+
+    close(fd);
+}
+
+void RecordFile::map(size_t capacity) {
+    size_t size = sizeof(Header) + capacity * recordSize;
+    int protection = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+
+    void* address = mmap(nullptr, size, protection, MAP_SHARED, fd, 0);
+
+    if(address == MAP_FAILED) {
+        throw systemError("Cannot map " + kind);
+    }
+
+    if(mapping) {
+        munmap(mapping, mappingSize);
+    }
+
+    mapping = static_cast<uint8_t*>(address);
+    mappingSize = size;
+    this->capacity = capacity;
+}
+
+RecordFile::Header& RecordFile::header() const {
+    return *reinterpret_cast<Header*>(mapping);
+}
+
+bool RecordFile::isWritable() const {
+    return writable;
+}
+
+size_t RecordFile::size() const {
+    return header().count;
+}
+
+void* RecordFile::record(size_t index) const {
+    return mapping + sizeof(Header) + index * recordSize;
+}
+
+void* RecordFile::reserve() {
+    size_t index = size();
+
+    if(index == capacity) {
+        size_t newCapacity = capacity < INITIAL_CAPACITY ? INITIAL_CAPACITY : 2 * capacity;
+
+        if(ftruncate(fd, sizeof(Header) + newCapacity * recordSize) != 0) {
+            throw systemError("Cannot grow " + kind);
+        }
+
+        map(newCapacity);
+    }
+
+    return record(index);
+}
+
+void RecordFile::commit() {
+    header().count = size() + 1;
+}
+
+void RecordFile::flush() {
+    msync(mapping, mappingSize, MS_SYNC);
+}
@@ -0,0 +1,74 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#ifndef recordFile_hpp
+#define recordFile_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/// File of records of a fixed size after a header, memory-mapped: the
+/// storage of SnapshotStore and RomCatalog. A record is found by offset and
+/// read straight from the mapping. The file grows by doubling its capacity,
+/// and gives back what it did not use when it is closed.
+///
+/// Several read-only files can map the same file from different threads.
+class RecordFile {
+private:
+    static const size_t INITIAL_CAPACITY = 64;
+
+    struct Header {
+        uint64_t magic;
+        uint32_t version;
+        uint32_t recordSize;
+        uint64_t count;
+        uint64_t reserved;
+    };
+
+    // What the file holds, e.g. "snapshot store", for the errors
+    std::string kind;
+    size_t recordSize;
+
+    int fd = -1;
+    bool writable;
+    uint8_t* mapping = nullptr;
+    size_t mappingSize = 0;
+    size_t capacity = 0;
+
+public:
+    /// Opens or, when writable, creates the file. Throws std::runtime_error
+    /// when it has another magic, version or record size.
+    RecordFile(const char* filename, bool writable, const char* kind, uint64_t magic,
+               uint32_t version, size_t recordSize);
+    ~RecordFile();
+
+    RecordFile(const RecordFile&) = delete;
+    RecordFile& operator=(const RecordFile&) = delete;
+
+    bool isWritable() const;
+
+    /// Records counted so far
+    size_t size() const;
+
+    void* record(size_t index) const;
+
+    /// Record `size()`, growing the file when it is full. It only becomes
+    /// part of the file once counted by commit. References to records
+    /// returned before are invalidated, the mapping may move.
+    void* reserve();
+    void commit();
+
+    /// Write the changes to the disk
+    void flush();
+
+private:
+    Header& header() const;
+    void map(size_t capacity);
+};
+
+#endif /* recordFile_hpp */
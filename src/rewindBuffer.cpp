@@ -0,0 +1,183 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#include <algorithm>
+#include <cstring>
+
+#include "cpu.hpp"
+#include "rewindBuffer.hpp"
+
+// =============================================================================
+// =============================================================================
+// =============================================================================
+// Encoding of a delta: pairs of (zeros, literals) counts as varints, each
+// followed by its literal bytes, until the whole state is covered
+
+static void writeVarint(std::vector<uint8_t>& out, size_t value) {
+    while(value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value) | 0x80);
+        value >>= 7;
+    }
+
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+static size_t readVarint(const uint8_t*& in) {
+    size_t value = 0;
+    int shift = 0;
+
+    while(*in & 0x80) {
+        value |= static_cast<size_t>(*in++ & 0x7F) << shift;
+        shift += 7;
+    }
+
+    return value | (static_cast<size_t>(*in++) << shift);
+}
+
+RewindBuffer::RewindBuffer(size_t capacity): ring(capacity) {
+    scratch.reserve(2 * sizeof(CPUState));
+}
+
+void RewindBuffer::encode(const uint8_t* delta, size_t size) {
+    scratch.clear();
+
+    size_t position = 0;
+
+    while(position < size) {
+        size_t start = position;
+
+        // Skip the unchanged bytes a word at a time
+        uint64_t word;
+        while(position + sizeof(word) <= size
+              && (memcpy(&word, &delta[position], sizeof(word)), word == 0)) {
+            position += sizeof(word);
+        }
+        while(position < size && delta[position] == 0) {
+            ++position;
+        }
+
+        size_t zeros = position - start;
+
+        start = position;
+        while(position < size && delta[position] != 0) {
+            ++position;
+        }
+
+        writeVarint(scratch, zeros);
+        writeVarint(scratch, position - start);
+        scratch.insert(scratch.end(), &delta[start], &delta[position]);
+    }
+}
+
+void RewindBuffer::decode(const uint8_t* encoded, size_t encodedSize, uint8_t* state, size_t size) {
+    const uint8_t* end = encoded + encodedSize;
+    size_t position = 0;
+
+    while(encoded < end && position < size) {
+        position += readVarint(encoded);
+        size_t literals = readVarint(encoded);
+
+        for(size_t i = 0; i < literals; ++i) {
+            state[position++] ^= *encoded++;
+        }
+    }
+}
+
+// =============================================================================
+// =============================================================================
+// =============================================================================
+// Ring of deltas
+
+void RewindBuffer::push(const uint8_t* bytes, size_t size) {
+    if(size > ring.size()) {
+        clear();
+        return;
+    }
+
+    while(used + size > ring.size()) {
+        head = (head + sizes.front()) % ring.size();
+        used -= sizes.front();
+        sizes.pop_front();
+    }
+
+    size_t offset = (head + used) % ring.size();
+    size_t first = std::min(size, ring.size() - offset);
+
+    memcpy(&ring[offset], bytes, first);
+    memcpy(&ring[0], bytes + first, size - first);
+
+    used += size;
+    sizes.push_back(size);
+}
+
+void RewindBuffer::popNewest(std::vector<uint8_t>& bytes) {
+    size_t size = sizes.back();
+    size_t offset = (head + used - size) % ring.size();
+    size_t first = std::min(size, ring.size() - offset);
+
+    bytes.resize(size);
+    memcpy(bytes.data(), &ring[offset], first);
+    memcpy(bytes.data() + first, &ring[0], size - first);
+
+    used -= size;
+    sizes.pop_back();
+}
+
+// =============================================================================
+// =============================================================================
+// =============================================================================
+// Recording and rewinding
+
+void RewindBuffer::record(const CPU& cpu) {
+    CPUState current;
+    cpu.saveState(current);
+
+    if(hasLast) {
+        uint8_t* lastBytes = reinterpret_cast<uint8_t*>(&last);
+        const uint8_t* currentBytes = reinterpret_cast<const uint8_t*>(&current);
+
+        // Turn the last state into the delta, then into the current state
+        for(size_t i = 0; i < sizeof(CPUState); ++i) {
+            lastBytes[i] ^= currentBytes[i];
+        }
+
+        encode(lastBytes, sizeof(CPUState));
+        push(scratch.data(), scratch.size());
+    }
+
+    last = current;
+    hasLast = true;
+}
+
+bool RewindBuffer::rewind(CPU& cpu) {
+    if(sizes.empty()) {
+        return false;
+    }
+
+    std::vector<uint8_t> encoded;
+    popNewest(encoded);
+    decode(encoded.data(), encoded.size(), reinterpret_cast<uint8_t*>(&last), sizeof(CPUState));
+
+    cpu.loadState(last);
+
+    return true;
+}
+
+void RewindBuffer::clear() {
+    head = 0;
+    used = 0;
+    sizes.clear();
+    hasLast = false;
+}
+
+size_t RewindBuffer::frames() const {
+    return sizes.size();
+}
+
+size_t RewindBuffer::memoryUsed() const {
+    return used;
+}
@@ -0,0 +1,65 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#ifndef rewindBuffer_hpp
+#define rewindBuffer_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "cpuState.hpp"
+
+class CPU;
+
+/// History of the frames of a CPU, to step backwards in time.
+///
+/// Only the last recorded state is kept whole. Every frame before it is
+/// the XOR of two consecutive states, run-length encoded: most frames only
+/// touch a few bytes, so a delta is mostly zeros and takes a few bytes.
+/// XOR-ing the newest delta into the last state gives back the frame
+/// before it. Deltas live in a ring of fixed size, the oldest are dropped
+/// when it is full.
+class RewindBuffer {
+private:
+    static const size_t DEFAULT_CAPACITY = 4 << 20;
+
+    std::vector<uint8_t> ring;
+    size_t head = 0;
+    size_t used = 0;
+    // Size of every delta in the ring, oldest first
+    std::deque<size_t> sizes;
+
+    CPUState last;
+    bool hasLast = false;
+
+    std::vector<uint8_t> scratch;
+
+public:
+    explicit RewindBuffer(size_t capacity = DEFAULT_CAPACITY);
+
+    /// Call once per frame, outside of the instructions of the frame
+    void record(const CPU& cpu);
+
+    /// Load the frame before the last one recorded. Returns false when
+    /// there is no history left.
+    bool rewind(CPU& cpu);
+
+    void clear();
+
+    size_t frames() const;
+    size_t memoryUsed() const;
+
+private:
+    void encode(const uint8_t* delta, size_t size);
+    void decode(const uint8_t* encoded, size_t encodedSize, uint8_t* state, size_t size);
+    void push(const uint8_t* bytes, size_t size);
+    void popNewest(std::vector<uint8_t>& bytes);
+};
+
+#endif /* rewindBuffer_hpp */
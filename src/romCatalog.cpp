@@ -0,0 +1,87 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "quirks.hpp"
+#include "romCatalog.hpp"
+
+/// The info is handed to the CPU and the frontends as is: the quirks have to
+/// be a profile and the title a string
+static bool isValid(const RomInfo& info) {
+    return quirksName(info.quirks) != nullptr && memchr(info.title, '\0', RomInfo::TITLE_SIZE) != nullptr;
+}
+
+RomCatalog::RomCatalog(const char* filename, bool writable):
+    file(filename, writable, "ROM catalog", MAGIC, VERSION, sizeof(Entry)) {
+    for(size_t i = 0; i < file.size(); ++i) {
+        const Entry& entry = entryAt(i);
+
+        if(entry.size > RomImage::MAX_SIZE || !isValid(entry.info)) {
+            throw std::runtime_error(std::string("Corrupted ROM catalog: ") + filename + ", entry "
+                                     + std::to_string(i));
+        }
+
+        hashes[entry.hash] = i;
+    }
+}
+
+RomCatalog::Entry& RomCatalog::entryAt(size_t index) const {
+    return *static_cast<Entry*>(file.record(index));
+}
+
+size_t RomCatalog::put(const RomImage& rom, const RomInfo& info) {
+    if(!file.isWritable()) {
+        throw std::runtime_error("ROM catalog opened read-only");
+    }
+
+    if(!isValid(info)) {
+        throw std::runtime_error("Invalid info for a ROM catalog entry");
+    }
+
+    auto it = hashes.find(rom.hash());
+
+    if(it != hashes.end()) {
+        entryAt(it->second).info = info;
+        return it->second;
+    }
+
+    size_t index = size();
+
+    Entry& newEntry = *static_cast<Entry*>(file.reserve());
+    memset(&newEntry, 0, sizeof(Entry));
+    newEntry.hash = rom.hash();
+    newEntry.size = static_cast<uint32_t>(rom.size());
+    newEntry.info = info;
+    memcpy(newEntry.rom, rom.data(), rom.size());
+
+    // The entry only becomes part of the catalog once it is counted
+    file.commit();
+    hashes[newEntry.hash] = index;
+
+    return index;
+}
+
+size_t RomCatalog::size() const {
+    return file.size();
+}
+
+const RomCatalog::Entry& RomCatalog::entry(size_t index) const {
+    return entryAt(index);
+}
+
+const RomCatalog::Entry* RomCatalog::find(uint64_t hash) const {
+    auto it = hashes.find(hash);
+
+    return it == hashes.end() ? nullptr : &entryAt(it->second);
+}
+
+void RomCatalog::flush() {
+    file.flush();
+}
@@ -0,0 +1,91 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#ifndef romCatalog_hpp
+#define romCatalog_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+
+#include "recordFile.hpp"
+#include "romImage.hpp"
+
+/// What is known of a ROM beyond its content
+struct RomInfo {
+    static const size_t TITLE_SIZE = 64;
+    static const size_t KEYMAP_SIZE = 16;
+
+    // Nul-terminated, empty when unknown
+    char title[TITLE_SIZE];
+
+    // Quirks the ROM expects, one of the profiles of quirks.hpp
+    uint32_t quirks;
+
+    // 0 when unknown, the caller then picks its own
+    uint32_t instructionsPerFrame;
+
+    // Host key of each CHIP-8 key 0 to F, e.g. "x123qweasdzc4rfv",
+    // nul bytes for the default mapping
+    char keymap[KEYMAP_SIZE];
+};
+
+/// File of ROMs keyed by the hash of their content, memory-mapped like the
+/// SnapshotStore, see RecordFile. Each entry holds the ROM itself and its RomInfo in a
+/// record of fixed size, so a batch of thousands of jobs opens one file
+/// and loads every ROM straight from the mapping, without opening, reading
+/// or hashing the ROM files again.
+///
+/// Several read-only catalogs can map the same file from different threads.
+class RomCatalog {
+public:
+    struct Entry {
+        uint64_t hash;
+        uint32_t size;
+        uint32_t reserved;
+        RomInfo info;
+        uint8_t rom[RomImage::MAX_SIZE];
+    };
+
+private:
+    static const uint64_t MAGIC = 0x00474C5443384843ull; // "CH8CTLG"
+    static const uint32_t VERSION = 1;
+
+    RecordFile file;
+
+    std::unordered_map<uint64_t, size_t> hashes;
+
+public:
+    /// Opens or, when writable, creates the catalog.
+    /// Throws std::runtime_error when the file is not a compatible catalog,
+    /// or when one of its entries is not valid: a ROM larger than MAX_SIZE,
+    /// quirks that are not a profile or a title without its nul.
+    RomCatalog(const char* filename, bool writable = true);
+
+    RomCatalog(const RomCatalog&) = delete;
+    RomCatalog& operator=(const RomCatalog&) = delete;
+
+    /// Add a ROM, or replace the info of the entry with the same content.
+    /// Throws std::runtime_error when the info is not valid, see above.
+    /// Returns the index of its entry. References to entries returned
+    /// before are invalidated, the mapping may move.
+    size_t put(const RomImage& rom, const RomInfo& info);
+
+    size_t size() const;
+    const Entry& entry(size_t index) const;
+
+    /// Entry of the ROM whose content hashes to `hash`, or nullptr
+    const Entry* find(uint64_t hash) const;
+
+    /// Write the changes to the disk
+    void flush();
+
+private:
+    Entry& entryAt(size_t index) const;
+};
+
+#endif /* romCatalog_hpp */
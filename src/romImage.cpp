@@ -0,0 +1,70 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "hash.hpp"
+#include "romImage.hpp"
+#include "systemError.hpp"
+
+RomImage::RomImage(const char* filename) {
+    int fd = open(filename, O_RDONLY);
+
+    if(fd < 0) {
+        throw systemError(std::string("Cannot open ROM ") + filename);
+    }
+
+    struct stat status;
+    if(fstat(fd, &status) != 0) {
+        close(fd);
+        throw systemError(std::string("Cannot stat ROM ") + filename);
+    }
+
+    length = status.st_size;
+
+    // Checked before mapping: a zero-sized mapping fails, and a larger one
+    // would overrun the ram when loaded
+    if(length == 0 || length > MAX_SIZE) {
+        close(fd);
+        throw std::runtime_error(std::string("ROM ") + filename + " has " + std::to_string(length)
+                                 + " bytes, expected 1 to " + std::to_string(MAX_SIZE));
+    }
+
+    // The mapping outlives the descriptor
+    void* address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if(address == MAP_FAILED) {
+        throw systemError(std::string("Cannot map ROM ") + filename);
+    }
+
+    mapping = static_cast<const uint8_t*>(address);
+    contentHash = hashBytes(mapping, length);
+}
+
+RomImage::~RomImage() {
+    munmap(const_cast<uint8_t*>(mapping), length);
+}
+
+const uint8_t* RomImage::data() const {
+    return mapping;
+}
+
+size_t RomImage::size() const {
+    return length;
+}
+
+uint64_t RomImage::hash() const {
+    return contentHash;
+}
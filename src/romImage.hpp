@@ -0,0 +1,44 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#ifndef romImage_hpp
+#define romImage_hpp
+
+#include <cstddef>
+#include <cstdint>
+
+/// A ROM file, memory-mapped read-only. The size is checked against the
+/// room left in ram after CPU::STARTING_ADDRESS when the file is opened,
+/// and the content is hashed once, so the hash identifies the ROM whatever
+/// its path, e.g. in a RomCatalog.
+class RomImage {
+public:
+    // RAM_SIZE - STARTING_ADDRESS of the CPU, checked in cpu.cpp
+    static const size_t MAX_SIZE = 0x1000 - 0x200;
+
+private:
+    const uint8_t* mapping = nullptr;
+    size_t length = 0;
+    uint64_t contentHash = 0;
+
+public:
+    /// Throws std::runtime_error when the file cannot be mapped, or is
+    /// empty or larger than MAX_SIZE
+    explicit RomImage(const char* filename);
+    ~RomImage();
+
+    RomImage(const RomImage&) = delete;
+    RomImage& operator=(const RomImage&) = delete;
+
+    const uint8_t* data() const;
+    size_t size() const;
+
+    /// hashBytes of the content
+    uint64_t hash() const;
+};
+
+#endif /* romImage_hpp */
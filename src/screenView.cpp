@@ -6,10 +6,17 @@
 //  Copyright © 2020 Cosme Jordan. All rights reserved.
 //
 
+#include <algorithm>
+#include <stdexcept>
+
 #include "screenView.hpp"
+#include "framebuffer.hpp"
+
+const char* const ScreenView::DEFAULT_KEYMAP = "x123qweasdzc4rfv";
 
 ScreenView::ScreenView(SDLWindowSpecification& sdlWindowSpecification) {
     this->sdlWindowSpecification = sdlWindowSpecification;
+    setKeymap(DEFAULT_KEYMAP);
 }
 
 ScreenView::~ScreenView() {
@@ -25,10 +32,21 @@ void ScreenView::initSDL() {
 
     renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
 
+    createTexture(sdlWindowSpecification.textureWidth, sdlWindowSpecification.textureHeight);
+}
+
+/// The texture has the resolution of the framebuffer, and is stretched over
+/// the window
+void ScreenView::createTexture(int width, int height) {
+    if(texture) {
+        SDL_DestroyTexture(texture);
+    }
+
+    sdlWindowSpecification.textureWidth = width;
+    sdlWindowSpecification.textureHeight = height;
+
     texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888,
-                                SDL_TEXTUREACCESS_STREAMING,
-                                sdlWindowSpecification.textureWidth,
-                                sdlWindowSpecification.textureHeight);
+                                SDL_TEXTUREACCESS_STREAMING, width, height);
 }
 
 void ScreenView::destorySDL() {
@@ -38,132 +56,110 @@ void ScreenView::destorySDL() {
     SDL_Quit();
 }
 
-void ScreenView::draw(void const* buffer, int pitch) {
-    SDL_UpdateTexture(texture, nullptr, buffer, pitch);
+/// Only uploads the rows changed since the last presented frame, or still
+/// fading, and does not render at all when no pixel changed
+void ScreenView::draw(const Framebuffer& framebuffer) {
+    unsigned int begin = 0;
+    unsigned int end = 0;
+
+    presentedGeneration = framebuffer.generation;
+
+    if(!presenter.present(framebuffer, begin, end)) {
+        inputLatency.presented(InputLatency::Clock::now(), presentedGeneration);
+        return;
+    }
+
+    // The ROM switched between low and high resolution
+    if(static_cast<int>(presenter.getWidth()) != sdlWindowSpecification.textureWidth
+       || static_cast<int>(presenter.getHeight()) != sdlWindowSpecification.textureHeight) {
+        createTexture(presenter.getWidth(), presenter.getHeight());
+    }
+
+    int width = sdlWindowSpecification.textureWidth;
+    int pitch = sizeof(uint32_t) * width;
+    SDL_Rect rows = { 0, static_cast<int>(begin), width, static_cast<int>(end - begin) };
+    SDL_UpdateTexture(texture, &rows, presenter.getPixels() + begin * width, pitch);
     SDL_RenderClear(renderer);
     SDL_RenderCopy(renderer, texture, nullptr, nullptr);
     SDL_RenderPresent(renderer);
+
+    inputLatency.presented(InputLatency::Clock::now(), presentedGeneration);
 }
 
+/// Every key event is stamped with the time SDL received it rather than
+/// with the time it is polled, up to a frame later
 bool ScreenView::inputKeys(uint8_t* keys) {
     bool quit = false;
     
     SDL_Event event;
+
+    // SDL stamps its events in milliseconds since its start. The events are
+    // pumped first so that they are stamped before `ticks`, though one can
+    // still come in while polling.
+    SDL_PumpEvents();
+    InputLatency::Clock::time_point now = InputLatency::Clock::now();
+    Uint32 ticks = SDL_GetTicks();
     
     while(SDL_PollEvent(&event)) {
         switch (event.type) {
             case SDL_QUIT:
                 quit = true;
                 break;
+            case SDL_WINDOWEVENT:
+                // The window content was lost, present the whole frame again
+                if(event.window.event == SDL_WINDOWEVENT_EXPOSED) {
+                    presenter.invalidate();
+                }
+                break;
             case SDL_KEYDOWN:
-                switch (event.key.keysym.sym) {
-                    case SDLK_ESCAPE:
-                        quit = true;
-                        break;
-                    case SDLK_x:
-                        keys[0] = 1;
-                        break;
-                    case SDLK_1:
-                        keys[1] = 1;
-                        break;
-                    case SDLK_2:
-                        keys[2] = 1;
-                        break;
-                    case SDLK_3:
-                        keys[3] = 1;
-                        break;
-                    case SDLK_q:
-                        keys[4] = 1;
-                        break;
-                    case SDLK_w:
-                        keys[5] = 1;
-                        break;
-                    case SDLK_e:
-                        keys[6] = 1;
-                        break;
-                    case SDLK_a:
-                        keys[7] = 1;
-                        break;
-                    case SDLK_s:
-                        keys[8] = 1;
-                        break;
-                    case SDLK_d:
-                        keys[9] = 1;
-                        break;
-                    case SDLK_z:
-                        keys[0xA] = 1;
-                        break;
-                    case SDLK_c:
-                        keys[0xB] = 1;
-                        break;
-                    case SDLK_4:
-                        keys[0xC] = 1;
-                        break;
-                    case SDLK_r:
-                        keys[0xD] = 1;
-                        break;
-                    case SDLK_f:
-                        keys[0xE] = 1;
-                        break;
-                    case SDLK_v:
-                        keys[0xF] = 1;
-                        break;
-                } break;
-
-            case SDL_KEYUP:
-                switch (event.key.keysym.sym) {
-                    case SDLK_x:
-                        keys[0] = 0;
-                        break;
-                    case SDLK_1:
-                        keys[1] = 0;
-                        break;
-                    case SDLK_2:
-                        keys[2] = 0;
-                        break;
-                    case SDLK_3:
-                        keys[3] = 0;
-                        break;
-                    case SDLK_q:
-                        keys[4] = 0;
-                        break;
-                    case SDLK_w:
-                        keys[5] = 0;
-                        break;
-                    case SDLK_e:
-                        keys[6] = 0;
-                        break;
-                    case SDLK_a:
-                        keys[7] = 0;
-                        break;
-                    case SDLK_s:
-                        keys[8] = 0;
-                        break;
-                    case SDLK_d:
-                        keys[9] = 0;
-                        break;
-                    case SDLK_z:
-                        keys[0xA] = 0;
-                        break;
-                    case SDLK_c:
-                        keys[0xB] = 0;
-                        break;
-                    case SDLK_4:
-                        keys[0xC] = 0;
-                        break;
-                    case SDLK_r:
-                        keys[0xD] = 0;
-                        break;
-                    case SDLK_f:
-                        keys[0xE] = 0;
-                        break;
-                        
-                    case SDLK_v:
-                        keys[0xF] = 0;
-                        break;
-                } break;
+            case SDL_KEYUP: {
+                bool pressed = event.type == SDL_KEYDOWN;
+                SDL_Scancode scancode = event.key.keysym.scancode;
+
+                if(scancode == SDL_SCANCODE_ESCAPE) {
+                    quit = quit || pressed;
+                } else if(scancode == SDL_SCANCODE_BACKSPACE) {
+                    rewinding = pressed;
+                } else if(scancode >= 0 && scancode < SDL_NUM_SCANCODES && keymap[scancode] != NO_KEY) {
+                    keys[keymap[scancode]] = pressed;
+
+                    if(pressed && !event.key.repeat) {
+                        // Uint32: a key stamped after `ticks` would be 49 days old
+                        Uint32 timestamp = event.key.timestamp;
+                        std::chrono::milliseconds age(timestamp < ticks ? ticks - timestamp : 0);
+                        inputLatency.keyPressed(now - age, presentedGeneration);
+                    }
+                }
+            } break;
         }
     }
     
     return quit;
 }
+
+bool ScreenView::isRewinding() const {
+    return rewinding;
+}
+
+Presenter& ScreenView::getPresenter() {
+    return presenter;
+}
+
+void ScreenView::setKeymap(const char* keymap) {
+    std::fill(this->keymap, this->keymap + SDL_NUM_SCANCODES, NO_KEY);
+
+    for(unsigned int key = 0; key < 16; ++key) {
+        char name[2] = { keymap[key] ? keymap[key] : DEFAULT_KEYMAP[key], 0 };
+        SDL_Scancode scancode = SDL_GetScancodeFromName(name);
+
+        if(scancode == SDL_SCANCODE_UNKNOWN) {
+            throw std::runtime_error(std::string("Unknown key ") + name + " in keymap");
+        }
+
+        this->keymap[scancode] = key;
+    }
+}
+
+const InputLatency& ScreenView::getInputLatency() const {
+    return inputLatency;
+}
@@ -12,6 +12,11 @@
 #include <iostream>
 #include <SDL.h>
 #include <string>
+#include <vector>
+
+#include "inputLatency.hpp"
+#include "presenter.hpp"
+#include "sinks.hpp"
 
 struct SDLWindowSpecification {
     int height;
@@ -22,7 +27,7 @@ struct SDLWindowSpecification {
     char const* screenTitle;
 };
 
-class ScreenView {
+class ScreenView: public DisplaySink {
 private:
     SDLWindowSpecification sdlWindowSpecification;
     
@@ -30,14 +35,46 @@ private:
 	SDL_Renderer* renderer = NULL;
 	SDL_Texture* texture = NULL;
 
+    // RGBA expansion of the framebuffer uploaded to the texture
+    Presenter presenter;
+
+    // Backspace is held down, see RewindBuffer
+    bool rewinding = false;
+
+    // CHIP-8 key of each scancode, NO_KEY for the others. Scancodes are
+    // the positions of the keys, so the layout stays the same whatever the
+    // language of the keyboard.
+    static const int8_t NO_KEY = -1;
+    int8_t keymap[SDL_NUM_SCANCODES];
+
+    InputLatency inputLatency;
+    uint64_t presentedGeneration = 0;
+
+    void createTexture(int width, int height);
+
 public:
+    // Host key of each CHIP-8 key 0 to F, see the keyboard mapping in main.cpp
+    static const char* const DEFAULT_KEYMAP;
+
     ScreenView(SDLWindowSpecification& sdlWindowSpecification);
     ~ScreenView();
     void initSDL();
     void destorySDL();
     
-    void draw(void const* buffer, int pitch);
+    void draw(const Framebuffer& framebuffer) override;
     bool inputKeys(uint8_t* keys);
+    bool isRewinding() const;
+
+    /// Host key of each CHIP-8 key 0 to F, as in RomInfo::keymap, e.g.
+    /// "x123qweasdzc4rfv". A nul byte keeps the default key. Throws
+    /// std::runtime_error on a key SDL doesn't know.
+    void setKeymap(const char* keymap);
+
+    /// Latency from the keys pressed to the frames presented
+    const InputLatency& getInputLatency() const;
+
+    /// Palette and persistence of the display
+    Presenter& getPresenter();
 };
 
 #endif /* screenView_hpp */
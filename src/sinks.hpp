@@ -0,0 +1,29 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#ifndef sinks_hpp
+#define sinks_hpp
+
+/// Output devices of the CPU. The core only talks to these interfaces, so
+/// it can run without any SDL window or audio device behind it: a CPU
+/// without sinks is simply headless.
+
+class Framebuffer;
+
+class SoundSink {
+public:
+    virtual ~SoundSink() = default;
+    virtual void play(double frequency, int duration) = 0;
+};
+
+class DisplaySink {
+public:
+    virtual ~DisplaySink() = default;
+    virtual void draw(const Framebuffer& framebuffer) = 0;
+};
+
+#endif /* sinks_hpp */
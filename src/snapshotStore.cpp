@@ -0,0 +1,63 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#include <cstring>
+#include <stdexcept>
+
+#include "snapshotStore.hpp"
+
+SnapshotStore::SnapshotStore(const char* filename, bool writable):
+    file(filename, writable, "snapshot store", MAGIC, VERSION, sizeof(Record)) {
+    for(size_t i = 0; i < file.size(); ++i) {
+        keys[record(i).key] = i;
+    }
+}
+
+SnapshotStore::Record& SnapshotStore::record(size_t index) const {
+    return *static_cast<Record*>(file.record(index));
+}
+
+size_t SnapshotStore::append(uint64_t key, const CPUState& state) {
+    if(!file.isWritable()) {
+        throw std::runtime_error("Snapshot store opened read-only");
+    }
+
+    size_t index = size();
+
+    Record& newRecord = *static_cast<Record*>(file.reserve());
+    newRecord.key = key;
+    newRecord.reserved = 0;
+    memcpy(&newRecord.state, &state, sizeof(CPUState));
+
+    // The record only becomes part of the store once it is counted
+    file.commit();
+    keys[key] = index;
+
+    return index;
+}
+
+size_t SnapshotStore::size() const {
+    return file.size();
+}
+
+uint64_t SnapshotStore::key(size_t index) const {
+    return record(index).key;
+}
+
+const CPUState& SnapshotStore::state(size_t index) const {
+    return record(index).state;
+}
+
+const CPUState* SnapshotStore::find(uint64_t key) const {
+    auto it = keys.find(key);
+
+    return it == keys.end() ? nullptr : &record(it->second).state;
+}
+
+void SnapshotStore::flush() {
+    file.flush();
+}
@@ -0,0 +1,66 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#ifndef snapshotStore_hpp
+#define snapshotStore_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+
+#include "cpuState.hpp"
+#include "recordFile.hpp"
+
+/// Append-only file of CPU states, memory-mapped, see RecordFile. Every
+/// record has the same size, so a state is found by offset and restored
+/// straight from the mapping, without parsing. Each state is tagged with a key chosen by the
+/// caller, e.g. a frame number.
+///
+/// Several read-only stores can map the same file from different threads.
+class SnapshotStore {
+private:
+    static const uint64_t MAGIC = 0x0053504E53384843ull; // "CH8SNPS"
+    static const uint32_t VERSION = 1;
+
+    struct Record {
+        uint64_t key;
+        uint64_t reserved;
+        CPUState state;
+    };
+
+    RecordFile file;
+
+    // Latest record of every key
+    std::unordered_map<uint64_t, size_t> keys;
+
+public:
+    /// Opens or, when writable, creates the store.
+    /// Throws std::runtime_error when the file is not a compatible store.
+    SnapshotStore(const char* filename, bool writable = true);
+
+    SnapshotStore(const SnapshotStore&) = delete;
+    SnapshotStore& operator=(const SnapshotStore&) = delete;
+
+    /// Returns the index of the new record. References to states returned
+    /// before are invalidated, the mapping may move.
+    size_t append(uint64_t key, const CPUState& state);
+
+    size_t size() const;
+    uint64_t key(size_t index) const;
+    const CPUState& state(size_t index) const;
+
+    /// Latest state appended with `key`, or nullptr
+    const CPUState* find(uint64_t key) const;
+
+    /// Write the appended records to the disk
+    void flush();
+
+private:
+    Record& record(size_t index) const;
+};
+
+#endif /* snapshotStore_hpp */
@@ -10,6 +10,8 @@
 void callback(void *_beeper, Uint8 *_stream, int _length);
 
 SimpleSound::SimpleSound() {
+    SDL_InitSubSystem(SDL_INIT_AUDIO);
+
     SDL_AudioSpec specification;
     SDL_AudioSpec finalSpecification;
 
@@ -41,7 +43,9 @@ SimpleSound::~SimpleSound() {
 void SimpleSound::generateWave(Sint16 *stream, int length) {
     int counter = 0;
     while(counter < length) {
-        if(sounds.empty()) {
+        SoundPair* soundPair = sounds.front();
+
+        if(soundPair == nullptr) {
             while (counter < length) {
                 stream[counter] = 0;
                 counter++;
@@ -49,47 +53,27 @@ void SimpleSound::generateWave(Sint16 *stream, int length) {
             return;
         }
 
-        SoundPair& soundPair = sounds.front();
-
-        
-        int samplesLeft = std::min(counter + soundPair.samplesLeft, length);
-        soundPair.samplesLeft -= samplesLeft - counter;
+        int samplesLeft = std::min(counter + soundPair->samplesLeft, length);
+        soundPair->samplesLeft -= samplesLeft - counter;
 
         while(counter < samplesLeft) {
             stream[counter] = AMPLITUDE * std::sin(2 * M_PI * linearSpeed / FREQUENCY);
-            linearSpeed += soundPair.frequency;
+            linearSpeed += soundPair->frequency;
             counter++;
         }
 
-        if(soundPair.samplesLeft == 0) {
+        if(soundPair->samplesLeft == 0) {
             sounds.pop();
         }
     }
 }
 
-void SimpleSound::emitSound(double frequency, int duration) {
+/// Queue the beep for the audio callback and return right away. A beep
+/// is dropped if the queue is full.
+void SimpleSound::play(double frequency, int duration) {
     SoundPair soundPair;
     soundPair.frequency = frequency;
     soundPair.samplesLeft = duration * FREQUENCY / 1000;
 
-    SDL_LockAudio();
     sounds.push(soundPair);
-    SDL_UnlockAudio();
-}
-
-void SimpleSound::wait() {
-    int soundSize;
-
-    do {
-        SDL_Delay(SDL_DELAY);
-        SDL_LockAudio();
-        soundSize = sounds.size();
-        SDL_UnlockAudio();
-    } while (soundSize > 0);
-
-}
-
-void SimpleSound::play(double frequency, int duration) {
-    emitSound(frequency, duration);
-    wait();
 }
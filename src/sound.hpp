@@ -9,39 +9,40 @@
 #ifndef sound_hpp
 #define sound_hpp
 
-#include <queue>
 #include <cmath>
 
 #include <SDL.h>
 #include <SDL_audio.h>
 
+#include "sinks.hpp"
+#include "spscQueue.hpp"
+
 struct SoundPair {
     double frequency;
     int samplesLeft;
 };
 
-class SimpleSound {
+class SimpleSound: public SoundSink {
 private:
     static const int AMPLITUDE = 28000;
     static const int FREQUENCY = 4400;
     static const int NUMBER_SAMPLES = 256;
     static const int NUMBER_CHANNELS = 1;
-    static const int SDL_DELAY = 10;
+    static const unsigned int QUEUE_CAPACITY = 64;
     
-    double linearSpeed;
-    std::queue<SoundPair> sounds;
+    double linearSpeed = 0;
+
+    // Filled by the emulation thread, drained by the audio callback
+    SpscQueue<SoundPair, QUEUE_CAPACITY> sounds;
 
 public:
     SimpleSound();
     ~SimpleSound();
 
 public:
-    void play(double frequency, int duration);
+    void play(double frequency, int duration) override;
     void generateWave(Sint16 *stream, int length);
 
-private:
-    void emitSound(double frequency, int duration);
-    void wait();
 };
 
 #endif /* sound_hpp */
@@ -0,0 +1,61 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#ifndef spscQueue_hpp
+#define spscQueue_hpp
+
+#include <atomic>
+
+/// Fixed-capacity queue between exactly one producer thread and one
+/// consumer thread. It never allocates nor locks, so it can be used from
+/// an audio callback.
+template<typename T, unsigned int CAPACITY>
+class SpscQueue {
+    static_assert(CAPACITY > 0 && (CAPACITY & (CAPACITY - 1)) == 0,
+                  "The capacity of a SpscQueue must be a power of two");
+
+private:
+    T items[CAPACITY];
+
+    // Only written by the consumer
+    std::atomic<unsigned int> head{0};
+    // Only written by the producer
+    std::atomic<unsigned int> tail{0};
+
+public:
+    /// Producer side. Returns false, dropping the item, when the queue is full
+    bool push(const T& item) {
+        unsigned int currentTail = tail.load(std::memory_order_relaxed);
+
+        if(currentTail - head.load(std::memory_order_acquire) == CAPACITY) {
+            return false;
+        }
+
+        items[currentTail & (CAPACITY - 1)] = item;
+        tail.store(currentTail + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    /// Consumer side. The item stays owned by the consumer until pop()
+    T* front() {
+        unsigned int currentHead = head.load(std::memory_order_relaxed);
+
+        if(currentHead == tail.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+
+        return &items[currentHead & (CAPACITY - 1)];
+    }
+
+    /// Consumer side, only after front() returned an item
+    void pop() {
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+};
+
+#endif /* spscQueue_hpp */
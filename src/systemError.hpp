@@ -0,0 +1,22 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#ifndef systemError_hpp
+#define systemError_hpp
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+/// Error of a call to the system that just failed: `message`, then what
+/// errno says
+inline std::runtime_error systemError(const std::string& message) {
+    return std::runtime_error(message + ": " + std::strerror(errno));
+}
+
+#endif /* systemError_hpp */
@@ -0,0 +1,110 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "cpu.hpp"
+#include "framePacer.hpp"
+#include "presenter.hpp"
+#include "romCatalog.hpp"
+#include "romImage.hpp"
+#include "terminalView.hpp"
+
+/// chip8-term: runs a ROM on the terminal, see TerminalView. Keys are the
+/// ones of chip8, Escape or Ctrl-C quits.
+///
+/// --braille draws 2x4 pixels per character instead of 1x2, for small
+/// terminals. CHIP8_CATALOG, CHIP8_PALETTE and CHIP8_FRAME_RING work as
+/// with chip8.
+
+// Timers of the CHIP-8 tick at 60 Hz, the emulator runs one frame per tick
+static const std::chrono::nanoseconds FRAME_PERIOD(1000000000 / 60);
+
+static void usage(const char* program) {
+    std::cerr << "Usage: " << program << " InstructionsPerFrame PathToROM [--braille]" << std::endl;
+    std::exit(EXIT_FAILURE);
+}
+
+int main(int argc, char* argv[]) {
+    if(argc != 3 && !(argc == 4 && !strcmp(argv[3], "--braille"))) {
+        usage(argv[0]);
+    }
+
+    unsigned int instructionsPerFrame = std::stoi(argv[1]);
+    TerminalView::Glyphs glyphs = argc == 4 ? TerminalView::Glyphs::Braille
+                                            : TerminalView::Glyphs::HalfBlocks;
+
+    std::unique_ptr<RomImage> rom;
+    std::unique_ptr<RomCatalog> catalog;
+    std::unique_ptr<FrameRing> frameRing;
+    const RomCatalog::Entry* entry = nullptr;
+
+    uint32_t palette[1u << Framebuffer::PLANES];
+    std::copy(Framebuffer::PALETTE, Framebuffer::PALETTE + (1u << Framebuffer::PLANES), palette);
+
+    TerminalView terminalView(glyphs);
+    CPU chip8;
+
+    try {
+        rom.reset(new RomImage(argv[2]));
+
+        if(const char* catalogFilename = std::getenv("CHIP8_CATALOG")) {
+            catalog.reset(new RomCatalog(catalogFilename, false));
+            entry = catalog->find(rom->hash());
+        }
+
+        if(const char* colors = std::getenv("CHIP8_PALETTE")) {
+            Presenter::parsePalette(colors, palette);
+        }
+
+        if(const char* frameRingName = std::getenv("CHIP8_FRAME_RING")) {
+            frameRing.reset(new FrameRing(frameRingName));
+        }
+
+        terminalView.setPalette(palette);
+        terminalView.open();
+    } catch(const std::exception& exception) {
+        std::cerr << "Error: " << exception.what() << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+
+    if(entry && entry->info.instructionsPerFrame && instructionsPerFrame == 0) {
+        instructionsPerFrame = entry->info.instructionsPerFrame;
+    }
+
+    chip8.setDisplaySink(&terminalView);
+    chip8.setFrameRing(frameRing.get());
+    chip8.loadROM(rom->data(), rom->size());
+    chip8.setQuirks(entry ? entry->info.quirks : Quirks::MODERN);
+    chip8.seedRandom(std::chrono::system_clock::now().time_since_epoch().count());
+
+    FramePacer framePacer(FRAME_PERIOD);
+    bool quit = false;
+
+    while(!quit) {
+        quit = terminalView.inputKeys(chip8.keyboard);
+        chip8.runFrame(instructionsPerFrame);
+        chip8.present();
+
+        framePacer.waitNextFrame();
+    }
+
+    terminalView.close();
+
+    uint64_t frames = std::max<uint64_t>(terminalView.getFramesWritten(), 1);
+    std::cout << terminalView.getBytesWritten() << " bytes written for "
+              << terminalView.getFramesWritten() << " frames that changed, "
+              << terminalView.getBytesWritten() / frames << " bytes per frame" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,265 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <stdexcept>
+#include <unistd.h>
+
+#include "terminalView.hpp"
+
+// Same layout as the SDL window, see main.cpp
+static const char KEYMAP[16] = {
+    'x', '1', '2', '3', 'q', 'w', 'e', 'a', 's', 'd', 'z', 'c', '4', 'r', 'f', 'v'
+};
+
+// Dot of each pixel of a 2x4 braille cell, by row then column
+static const uint8_t BRAILLE_DOTS[4][2] = {
+    { 0x01, 0x08 }, { 0x02, 0x10 }, { 0x04, 0x20 }, { 0x40, 0x80 }
+};
+
+static const char ESCAPE = 0x1B;
+static const char CTRL_C = 0x03;
+
+TerminalView::TerminalView(Glyphs glyphs): glyphs(glyphs) {
+    setPalette(Framebuffer::PALETTE);
+}
+
+TerminalView::~TerminalView() {
+    close();
+}
+
+void TerminalView::open() {
+    if(!isatty(STDIN_FILENO) || tcgetattr(STDIN_FILENO, &savedAttributes) != 0) {
+        throw std::runtime_error("stdin is not a terminal");
+    }
+
+    // Bytes as they are typed, without echo, signals or flow control, and
+    // reads that return at once
+    struct termios attributes = savedAttributes;
+    attributes.c_lflag &= ~(ICANON | ECHO | ISIG | IEXTEN);
+    attributes.c_iflag &= ~(IXON | ICRNL);
+    attributes.c_cc[VMIN] = 0;
+    attributes.c_cc[VTIME] = 0;
+    tcsetattr(STDIN_FILENO, TCSANOW, &attributes);
+    raw = true;
+
+    // Alternate screen, hidden cursor
+    output += "\x1b[?1049h\x1b[?25l";
+    fullRedraw = true;
+    flush();
+}
+
+void TerminalView::close() {
+    if(!raw) {
+        return;
+    }
+
+    output += "\x1b[0m\x1b[?25h\x1b[?1049l";
+    flush();
+
+    tcsetattr(STDIN_FILENO, TCSANOW, &savedAttributes);
+    raw = false;
+}
+
+void TerminalView::setPalette(const uint32_t* palette) {
+    std::copy(palette, palette + (1u << Framebuffer::PLANES), this->palette);
+    fullRedraw = true;
+}
+
+void TerminalView::draw(const Framebuffer& framebuffer) {
+    unsigned int cellWidth = glyphs == Glyphs::Braille ? 2 : 1;
+    unsigned int cellHeight = glyphs == Glyphs::Braille ? 4 : 2;
+
+    // The ROM switched between low and high resolution: the cells of the
+    // other one would stay on the terminal
+    if(framebuffer.width() / cellWidth != columns || framebuffer.height() / cellHeight != rows) {
+        columns = framebuffer.width() / cellWidth;
+        rows = framebuffer.height() / cellHeight;
+        cells.assign(columns * rows, 0);
+
+        output += "\x1b[0m\x1b[2J";
+        foreground = UINT32_MAX;
+        background = UINT32_MAX;
+        fullRedraw = true;
+    }
+
+    unsigned int begin = 0;
+    unsigned int end = framebuffer.height();
+
+    if(!fullRedraw && !framebuffer.dirtyRows(presentedGeneration, begin, end)) {
+        return;
+    }
+
+    bool everyCell = fullRedraw;
+    fullRedraw = false;
+    presentedGeneration = framebuffer.generation;
+
+    for(unsigned int row = begin / cellHeight; row < (end + cellHeight - 1) / cellHeight; ++row) {
+        for(unsigned int column = 0; column < columns; ++column) {
+            uint8_t cell = 0;
+
+            if(glyphs == Glyphs::Braille) {
+                for(unsigned int y = 0; y < 4; ++y) {
+                    for(unsigned int x = 0; x < 2; ++x) {
+                        cell |= framebuffer.pixel(2 * column + x, 4 * row + y) ? BRAILLE_DOTS[y][x] : 0;
+                    }
+                }
+            } else {
+                cell = framebuffer.pixel(column, 2 * row) | (framebuffer.pixel(column, 2 * row + 1) << 2);
+            }
+
+            uint8_t& previous = cells[row * columns + column];
+            if(cell == previous && !everyCell) {
+                continue;
+            }
+
+            previous = cell;
+            moveTo(row, column);
+            writeCell(cell);
+        }
+    }
+
+    if(!output.empty()) {
+        ++framesWritten;
+        flush();
+    }
+}
+
+void TerminalView::moveTo(unsigned int row, unsigned int column) {
+    // Writing a cell already moved the cursor to the next one
+    if(row != cursorRow || column != cursorColumn) {
+        output += "\x1b[" + std::to_string(row + 1) + ";" + std::to_string(column + 1) + "H";
+        cursorRow = row;
+        cursorColumn = column;
+    }
+}
+
+/// Colors are compared without their alpha, which the terminal ignores
+void TerminalView::setForeground(uint32_t color) {
+    if(color >> 8 != foreground) {
+        foreground = color >> 8;
+        output += "\x1b[38;2;" + std::to_string(foreground >> 16) + ";"
+            + std::to_string((foreground >> 8) & 0xFF) + ";" + std::to_string(foreground & 0xFF) + "m";
+    }
+}
+
+void TerminalView::setBackground(uint32_t color) {
+    if(color >> 8 != background) {
+        background = color >> 8;
+        output += "\x1b[48;2;" + std::to_string(background >> 16) + ";"
+            + std::to_string((background >> 8) & 0xFF) + ";" + std::to_string(background & 0xFF) + "m";
+    }
+}
+
+/// A plain CHIP-8 display only ever needs the colors of the first plane on
+/// off, so they are set once and each cell is a single character
+void TerminalView::writeCell(uint8_t cell) {
+    if(glyphs == Glyphs::Braille) {
+        setForeground(palette[1]);
+        setBackground(palette[0]);
+
+        if(cell == 0) {
+            output += ' ';
+        } else {
+            // U+2800 and the dots, in UTF-8
+            output += static_cast<char>(0xE2);
+            output += static_cast<char>(0xA0 | (cell >> 6));
+            output += static_cast<char>(0x80 | (cell & 0x3F));
+        }
+    } else {
+        unsigned int top = cell & 0x3;
+        unsigned int bottom = cell >> 2;
+
+        if(top == bottom && top == 0) {
+            setBackground(palette[0]);
+            output += ' ';
+        } else if(top == bottom) {
+            setForeground(palette[top]);
+            output += "█";
+        } else if(bottom == 0 || top == 0) {
+            setForeground(palette[top | bottom]);
+            setBackground(palette[0]);
+            output += top ? "▀" : "▄";
+        } else {
+            setForeground(palette[top]);
+            setBackground(palette[bottom]);
+            output += "▀";
+        }
+    }
+
+    ++cursorColumn;
+}
+
+void TerminalView::flush() {
+    size_t written = 0;
+
+    while(written < output.size()) {
+        ssize_t count = write(STDOUT_FILENO, output.data() + written, output.size() - written);
+
+        if(count < 0 && errno != EINTR) {
+            break;
+        }
+
+        written += count > 0 ? count : 0;
+    }
+
+    bytesWritten += written;
+    output.clear();
+}
+
+bool TerminalView::inputKeys(uint8_t* keys) {
+    bool quit = false;
+
+    for(unsigned int key = 0; key < 16; ++key) {
+        if(held[key] > 0 && --held[key] == 0) {
+            keys[key] = 0;
+        }
+    }
+
+    char buffer[64];
+    ssize_t count;
+
+    while((count = read(STDIN_FILENO, buffer, sizeof(buffer))) > 0) {
+        for(ssize_t i = 0; i < count; ++i) {
+            char byte = std::tolower(static_cast<unsigned char>(buffer[i]));
+
+            if(byte == CTRL_C) {
+                quit = true;
+            } else if(byte == ESCAPE) {
+                // Escape alone, or the start of a sequence such as an arrow
+                // key, skipped up to its final byte
+                if(i + 1 == count) {
+                    quit = true;
+                } else if(buffer[i + 1] == '[' || buffer[i + 1] == 'O') {
+                    i += 2;
+                    while(i < count && (buffer[i] < 0x40 || buffer[i] > 0x7E)) {
+                        ++i;
+                    }
+                }
+            } else {
+                const char* key = std::find(KEYMAP, KEYMAP + 16, byte);
+
+                if(key != KEYMAP + 16) {
+                    keys[key - KEYMAP] = 1;
+                    held[key - KEYMAP] = HOLD_FRAMES;
+                }
+            }
+        }
+    }
+
+    return quit;
+}
+
+uint64_t TerminalView::getBytesWritten() const {
+    return bytesWritten;
+}
+
+uint64_t TerminalView::getFramesWritten() const {
+    return framesWritten;
+}
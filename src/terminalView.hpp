@@ -0,0 +1,101 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#ifndef terminalView_hpp
+#define terminalView_hpp
+
+#include <cstdint>
+#include <string>
+#include <termios.h>
+#include <vector>
+
+#include "framebuffer.hpp"
+#include "sinks.hpp"
+
+/// Display and keyboard on an ANSI terminal, for machines without a
+/// window, e.g. over SSH.
+///
+/// The display is drawn with Unicode characters, either half blocks, one
+/// cell for 1x2 pixels in 24-bit colors, or braille, one cell for 2x4
+/// pixels in a single color. Each frame only writes the cells that changed
+/// since the previous one, with a cursor move before every run of them,
+/// and flushes it all in one write.
+///
+/// The keys are read from stdin in raw mode. A terminal never reports a
+/// key going up, so a key is held from its last byte for HOLD_FRAMES
+/// frames, which the auto-repeat of the terminal extends.
+class TerminalView: public DisplaySink {
+public:
+    enum class Glyphs {
+        HalfBlocks,
+        Braille
+    };
+
+    static const unsigned int HOLD_FRAMES = 8;
+
+private:
+    Glyphs glyphs;
+    uint32_t palette[1u << Framebuffer::PLANES];
+
+    // One per cell of the last frame written: colors of the pixels for half
+    // blocks, dots for braille
+    std::vector<uint8_t> cells;
+    unsigned int columns = 0;
+    unsigned int rows = 0;
+
+    // Generation of the framebuffer on the terminal, see Framebuffer::generation
+    uint64_t presentedGeneration = 0;
+    bool fullRedraw = true;
+
+    // Where the terminal is, to leave out cursor moves and colors it
+    // already has. UINT32_MAX is unknown.
+    unsigned int cursorRow = UINT32_MAX;
+    unsigned int cursorColumn = UINT32_MAX;
+    uint32_t foreground = UINT32_MAX;
+    uint32_t background = UINT32_MAX;
+
+    std::string output;
+    uint64_t bytesWritten = 0;
+    uint64_t framesWritten = 0;
+
+    // Frames left before each key is released
+    unsigned int held[16] = {};
+
+    struct termios savedAttributes;
+    bool raw = false;
+
+    void moveTo(unsigned int row, unsigned int column);
+    void setForeground(uint32_t color);
+    void setBackground(uint32_t color);
+    void writeCell(uint8_t cell);
+    void flush();
+
+public:
+    TerminalView(Glyphs glyphs = Glyphs::HalfBlocks);
+    ~TerminalView();
+
+    /// Switch stdin to raw mode and the terminal to its alternate screen.
+    /// Throws std::runtime_error when stdin is not a terminal.
+    void open();
+    /// Restore the terminal as it was, also done on destruction
+    void close();
+
+    /// 4 colors, for off, first plane, second plane and both. Braille
+    /// draws every lit pixel in the color of the first plane.
+    void setPalette(const uint32_t* palette);
+
+    void draw(const Framebuffer& framebuffer) override;
+
+    /// Once per frame: read the keys typed since the last call, and release
+    /// those held long enough. Returns true on Ctrl-C or Escape.
+    bool inputKeys(uint8_t* keys);
+
+    uint64_t getBytesWritten() const;
+    uint64_t getFramesWritten() const;
+};
+
+#endif /* terminalView_hpp */
@@ -0,0 +1,100 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "disassembler.hpp"
+#include "opcodeFamily.hpp"
+#include "traceRing.hpp"
+
+/// chip8-trace: prints a trace written by TraceRing as a disassembly, one
+/// executed instruction per line, with I and the register the instruction
+/// wrote as they were after it ran. Records the flushing thread missed
+/// show as a gap.
+
+static bool writesVx(uint16_t opcode) {
+    switch(family(opcode)) {
+        case Family::LD_KK:
+        case Family::ADD_KK:
+        case Family::LD_XY:
+        case Family::OR:
+        case Family::AND:
+        case Family::XOR:
+        case Family::ADD_XY:
+        case Family::SUB:
+        case Family::SHR:
+        case Family::SUBN:
+        case Family::SHL:
+        case Family::RND:
+        case Family::LD_VX_DT:
+        case Family::LD_VX_K:
+        case Family::LD_VX_MEM:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static void usage(const char* program) {
+    std::cerr << "Usage: " << program << " PathToTrace [--last N]" << std::endl;
+    std::exit(EXIT_FAILURE);
+}
+
+int main(int argc, char* argv[]) {
+    const char* filename = nullptr;
+    size_t last = 0;
+
+    for(int i = 1; i < argc; ++i) {
+        if(!strcmp(argv[i], "--last") && i + 1 < argc) {
+            last = std::strtoull(argv[++i], nullptr, 10);
+        } else if(argv[i][0] == '-' || filename) {
+            usage(argv[0]);
+        } else {
+            filename = argv[i];
+        }
+    }
+
+    if(filename == nullptr) {
+        usage(argv[0]);
+    }
+
+    std::vector<TraceRecord> records;
+    try {
+        records = TraceRing::load(filename);
+    } catch(const std::exception& exception) {
+        std::cerr << exception.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    size_t begin = last && last < records.size() ? records.size() - last : 0;
+
+    for(size_t i = begin; i < records.size(); ++i) {
+        const TraceRecord& record = records[i];
+
+        if(i > begin && record.index != records[i - 1].index + 1) {
+            std::printf("... %llu instructions lost\n",
+                        static_cast<unsigned long long>(record.index - records[i - 1].index - 1));
+        }
+
+        std::printf("%12llu  %03X  %04X  %-18s I=%03X", static_cast<unsigned long long>(record.index),
+                    record.pc, record.opcode, disassemble(record.opcode).c_str(), record.I);
+
+        if(writesVx(record.opcode)) {
+            std::printf("  V%X=%02X", record.x, record.vx);
+        }
+
+        std::printf("\n");
+    }
+
+    return 0;
+}
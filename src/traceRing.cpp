@@ -0,0 +1,211 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+
+#include "traceRing.hpp"
+
+struct TraceHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t recordSize;
+};
+
+struct ChunkHeader {
+    uint64_t first;
+    uint64_t count;
+};
+
+static const std::chrono::milliseconds FLUSH_PERIOD(10);
+
+static TraceRecord unpack(uint64_t index, uint64_t packed) {
+    TraceRecord record;
+    record.index = index;
+    record.pc = packed >> 48;
+    record.opcode = (packed >> 32) & 0xFFFF;
+    record.I = (packed >> 16) & 0xFFFF;
+    record.x = (packed >> 8) & 0xFF;
+    record.vx = packed & 0xFF;
+
+    return record;
+}
+
+static void writeHeader(std::FILE* file) {
+    TraceHeader header = { TraceRing::MAGIC, TraceRing::VERSION, sizeof(uint64_t) };
+    std::fwrite(&header, sizeof(header), 1, file);
+}
+
+static void writeChunk(std::FILE* file, uint64_t first, const std::vector<uint64_t>& packed) {
+    if(packed.empty()) {
+        return;
+    }
+
+    ChunkHeader chunk = { first, packed.size() };
+    std::fwrite(&chunk, sizeof(chunk), 1, file);
+    std::fwrite(packed.data(), sizeof(uint64_t), packed.size(), file);
+}
+
+TraceRing::TraceRing(size_t capacity) {
+    size_t rounded = 1;
+    while(rounded < capacity) {
+        rounded *= 2;
+    }
+
+    records.reset(new std::atomic<uint64_t>[rounded]);
+    mask = rounded - 1;
+}
+
+TraceRing::~TraceRing() {
+    stopFlushing();
+}
+
+/// Records of [begin, end) that are still in the ring, returns the index
+/// of the first one. The ring is read while the CPU keeps writing, so a
+/// record read may already be a newer one: whatever the head reached
+/// after the reads was overwritten.
+uint64_t TraceRing::copy(uint64_t begin, uint64_t end, std::vector<uint64_t>& packed) const {
+    packed.clear();
+
+    for(uint64_t i = begin; i < end; ++i) {
+        packed.push_back(records[i & mask].load(std::memory_order_acquire));
+    }
+
+    uint64_t current = head.load(std::memory_order_acquire);
+    uint64_t valid = current > mask ? current - mask : 0;
+
+    if(valid > begin) {
+        size_t overwritten = std::min(valid, end) - begin;
+        packed.erase(packed.begin(), packed.begin() + overwritten);
+
+        return begin + overwritten;
+    }
+
+    return begin;
+}
+
+void TraceRing::startFlushing(const char* filename) {
+    stopFlushing();
+
+    file = std::fopen(filename, "wb");
+    if(file == nullptr) {
+        throw std::runtime_error(std::string("Cannot create trace: ") + filename);
+    }
+
+    writeHeader(file);
+
+    stopping = false;
+    flushed = head.load(std::memory_order_acquire);
+    flusher = std::thread(&TraceRing::runFlusher, this);
+}
+
+void TraceRing::stopFlushing() {
+    if(!flusher.joinable()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(flusherMutex);
+        stopping = true;
+    }
+    flusherWakeUp.notify_one();
+    flusher.join();
+
+    std::fclose(file);
+    file = nullptr;
+}
+
+void TraceRing::flush() {
+    uint64_t end = head.load(std::memory_order_acquire);
+    uint64_t begin = end - flushed > mask ? end - mask : flushed;
+
+    uint64_t first = copy(begin, end, buffer);
+    lostRecords.fetch_add(first - flushed, std::memory_order_relaxed);
+
+    writeChunk(file, first, buffer);
+    flushed = end;
+}
+
+void TraceRing::runFlusher() {
+    std::unique_lock<std::mutex> lock(flusherMutex);
+
+    while(!stopping) {
+        flusherWakeUp.wait_for(lock, FLUSH_PERIOD);
+        flush();
+    }
+
+    std::fflush(file);
+}
+
+void TraceRing::dump(const char* filename) const {
+    std::FILE* output = std::fopen(filename, "wb");
+    if(output == nullptr) {
+        throw std::runtime_error(std::string("Cannot create trace: ") + filename);
+    }
+
+    uint64_t end = head.load(std::memory_order_acquire);
+    uint64_t begin = end > mask ? end - mask : 0;
+
+    std::vector<uint64_t> packed;
+    uint64_t first = copy(begin, end, packed);
+
+    writeHeader(output);
+    writeChunk(output, first, packed);
+
+    bool failed = std::ferror(output) != 0;
+    if(std::fclose(output) != 0 || failed) {
+        throw std::runtime_error(std::string("Cannot write trace: ") + filename);
+    }
+}
+
+uint64_t TraceRing::size() const {
+    return head.load(std::memory_order_acquire);
+}
+
+size_t TraceRing::capacity() const {
+    return mask + 1;
+}
+
+uint64_t TraceRing::lost() const {
+    return lostRecords.load(std::memory_order_relaxed);
+}
+
+std::vector<TraceRecord> TraceRing::load(const char* filename) {
+    std::FILE* input = std::fopen(filename, "rb");
+    if(input == nullptr) {
+        throw std::runtime_error(std::string("Trace doesn't exist: ") + filename);
+    }
+
+    TraceHeader header;
+    if(std::fread(&header, sizeof(header), 1, input) != 1 || header.magic != MAGIC
+       || header.version != VERSION || header.recordSize != sizeof(uint64_t)) {
+        std::fclose(input);
+        throw std::runtime_error(std::string("Not a trace: ") + filename);
+    }
+
+    std::vector<TraceRecord> loaded;
+    ChunkHeader chunk;
+
+    while(std::fread(&chunk, sizeof(chunk), 1, input) == 1) {
+        std::vector<uint64_t> packed(chunk.count);
+
+        if(std::fread(packed.data(), sizeof(uint64_t), packed.size(), input) != packed.size()) {
+            std::fclose(input);
+            throw std::runtime_error(std::string("Truncated trace: ") + filename);
+        }
+
+        for(uint64_t i = 0; i < chunk.count; ++i) {
+            loaded.push_back(unpack(chunk.first + i, packed[i]));
+        }
+    }
+
+    std::fclose(input);
+
+    return loaded;
+}
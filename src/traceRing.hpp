@@ -0,0 +1,108 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#ifndef traceRing_hpp
+#define traceRing_hpp
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// One executed instruction: its address and opcode, then I and the
+/// register x of the opcode as they are after it ran
+struct TraceRecord {
+    uint64_t index;
+    uint16_t pc;
+    uint16_t opcode;
+    uint16_t I;
+    uint8_t x;
+    uint8_t vx;
+};
+
+/// In-memory ring of the last executed instructions, cheap enough to be
+/// left on: recording one is two stores. Install it with CPU::setTrace.
+///
+/// A background thread can flush the ring to a file as it fills up. It
+/// never slows down the CPU: when it falls a whole ring behind, the
+/// records it missed are lost and show as a gap in the file. dump()
+/// writes the content of the ring at once, e.g. after a crash.
+///
+/// A trace file is a header followed by chunks of consecutive records,
+/// each chunk being its first index, its count and its records. Read it
+/// back with load() or with the chip8-trace tool.
+class TraceRing {
+public:
+    static const uint32_t MAGIC = 0x52543843; // "C8TR"
+    static const uint16_t VERSION = 1;
+    static const size_t DEFAULT_CAPACITY = 1 << 22;
+
+private:
+    // Records packed in a single word, so the flushing thread can read
+    // them while the CPU overwrites them
+    std::unique_ptr<std::atomic<uint64_t>[]> records;
+    size_t mask;
+
+    // Number of records written since the start
+    std::atomic<uint64_t> head{0};
+
+    std::FILE* file = nullptr;
+    std::thread flusher;
+    std::mutex flusherMutex;
+    std::condition_variable flusherWakeUp;
+    bool stopping = false;
+    uint64_t flushed = 0;
+    std::vector<uint64_t> buffer;
+    std::atomic<uint64_t> lostRecords{0};
+
+public:
+    /// The capacity is rounded up to a power of two
+    explicit TraceRing(size_t capacity = DEFAULT_CAPACITY);
+    ~TraceRing();
+
+    TraceRing(const TraceRing&) = delete;
+    TraceRing& operator=(const TraceRing&) = delete;
+
+    void record(uint16_t pc, uint16_t opcode, uint16_t I, uint8_t x, uint8_t vx) {
+        uint64_t index = head.load(std::memory_order_relaxed);
+        uint64_t packed = static_cast<uint64_t>(pc) << 48 | static_cast<uint64_t>(opcode) << 32
+                        | static_cast<uint64_t>(I) << 16 | static_cast<uint64_t>(x) << 8 | vx;
+
+        // Release: a reader that sees this record also sees the head that
+        // preceded it, see copy()
+        records[index & mask].store(packed, std::memory_order_release);
+        head.store(index + 1, std::memory_order_release);
+    }
+
+    /// Start the flushing thread. Throws std::runtime_error when the file
+    /// can not be created.
+    void startFlushing(const char* filename);
+    void stopFlushing();
+
+    /// Write the records still in the ring. Throws std::runtime_error when
+    /// the file can not be written.
+    void dump(const char* filename) const;
+
+    uint64_t size() const;
+    size_t capacity() const;
+    uint64_t lost() const;
+
+    /// Throws std::runtime_error when the file is not a trace
+    static std::vector<TraceRecord> load(const char* filename);
+
+private:
+    uint64_t copy(uint64_t begin, uint64_t end, std::vector<uint64_t>& packed) const;
+    void flush();
+    void runFlusher();
+};
+
+#endif /* traceRing_hpp */
@@ -0,0 +1,113 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#include "workStealingPool.hpp"
+
+WorkStealingPool::WorkStealingPool(unsigned int numberThreads) {
+    if(numberThreads == 0) {
+        numberThreads = 1;
+    }
+
+    for(unsigned int i = 0; i < numberThreads; ++i) {
+        workers.emplace_back(new Worker());
+    }
+
+    for(unsigned int i = 0; i < numberThreads; ++i) {
+        threads.emplace_back(&WorkStealingPool::run, this, i);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+
+    jobAvailable.notify_all();
+
+    for(std::thread& thread: threads) {
+        thread.join();
+    }
+}
+
+void WorkStealingPool::submit(Job job) {
+    Worker& worker = *workers[nextWorker++ % workers.size()];
+
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.jobs.push_back(std::move(job));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++queued;
+        ++unfinished;
+    }
+
+    jobAvailable.notify_one();
+}
+
+void WorkStealingPool::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    allFinished.wait(lock, [this] { return unfinished == 0; });
+}
+
+unsigned int WorkStealingPool::size() const {
+    return workers.size();
+}
+
+/// Newest job of the own deque, or else oldest job of another worker
+bool WorkStealingPool::take(unsigned int index, Job& job) {
+    for(unsigned int i = 0; i < workers.size(); ++i) {
+        Worker& worker = *workers[(index + i) % workers.size()];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+
+        if(worker.jobs.empty()) {
+            continue;
+        }
+
+        if(i == 0) {
+            job = std::move(worker.jobs.back());
+            worker.jobs.pop_back();
+        } else {
+            job = std::move(worker.jobs.front());
+            worker.jobs.pop_front();
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+void WorkStealingPool::run(unsigned int index) {
+    while(true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobAvailable.wait(lock, [this] { return queued > 0 || stopping; });
+
+            if(queued == 0) {
+                return;
+            }
+
+            // Claiming a job guarantees that one is left in some deque
+            --queued;
+        }
+
+        Job job;
+        while(!take(index, job)) {
+            std::this_thread::yield();
+        }
+
+        job();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if(--unfinished == 0) {
+            allFinished.notify_all();
+        }
+    }
+}
@@ -0,0 +1,65 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#ifndef workStealingPool_hpp
+#define workStealingPool_hpp
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// Thread pool where every worker has its own deque of jobs. A worker runs
+/// its newest job first, and when its deque is empty it steals the oldest
+/// job of another worker, so uneven jobs still keep every core busy.
+class WorkStealingPool {
+public:
+    typedef std::function<void()> Job;
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    unsigned int nextWorker = 0;
+
+    // Jobs pushed to a deque and not yet claimed by a worker, and jobs not
+    // finished yet
+    std::mutex mutex;
+    std::condition_variable jobAvailable;
+    std::condition_variable allFinished;
+    unsigned int queued = 0;
+    unsigned int unfinished = 0;
+    bool stopping = false;
+
+public:
+    explicit WorkStealingPool(unsigned int numberThreads = std::thread::hardware_concurrency());
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    /// Jobs must not throw
+    void submit(Job job);
+
+    /// Block until every submitted job has finished
+    void wait();
+
+    unsigned int size() const;
+
+private:
+    void run(unsigned int index);
+    bool take(unsigned int index, Job& job);
+};
+
+#endif /* workStealingPool_hpp */
@@ -0,0 +1,90 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+#include "compiledRom.hpp"
+#include "cpu.hpp"
+
+/// Runs ROMs compiled by chip8-aot, see CMakeLists.txt, on
+/// Dispatch::Compiled and on Dispatch::Table, and checks that they reach
+/// the same state, and that the compiled code is only dropped when the ROM
+/// writes over one of its instructions.
+
+extern const CompiledROM compiledROM_writesData;
+extern const CompiledROM compiledROM_writesCode;
+
+static const unsigned int FRAMES = 60;
+static const unsigned int INSTRUCTIONS_PER_FRAME = 11;
+
+static unsigned int failures = 0;
+
+static void check(bool condition, const char* rom, const char* what) {
+    if(!condition) {
+        std::cerr << rom << ": " << what << std::endl;
+        ++failures;
+    }
+}
+
+static std::vector<uint8_t> readROM(const char* filename) {
+    std::ifstream file(filename, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+/// Returns whether the code was still compiled after the run
+static bool run(const char* filename, const CompiledROM& compiledROM) {
+    std::vector<uint8_t> rom = readROM(filename);
+    check(!rom.empty(), filename, "cannot read the ROM");
+
+    CPU reference;
+    reference.loadROM(rom.data(), rom.size());
+
+    CPU compiled;
+    compiled.loadROM(rom.data(), rom.size());
+    compiled.setDispatch(CPU::Dispatch::Compiled);
+    check(compiled.setCompiledROM(&compiledROM), filename, "compiled code rejected");
+
+    for(unsigned int frame = 0; frame < FRAMES; ++frame) {
+        reference.runFrame(INSTRUCTIONS_PER_FRAME);
+        compiled.runFrame(INSTRUCTIONS_PER_FRAME);
+    }
+
+    CPUState expected, actual;
+    reference.saveState(expected);
+    compiled.saveState(actual);
+    check(std::memcmp(&expected, &actual, sizeof(expected)) == 0, filename, "diverged from table");
+
+    // A state saved after a write to the data still matches the code
+    bool stillCompiled = CompiledAccess::compiled(compiled);
+    compiled.loadState(actual);
+    check(CompiledAccess::compiled(compiled) == stillCompiled, filename,
+          "loading a state changed whether the code is compiled");
+
+    return stillCompiled;
+}
+
+int main(int argc, char* argv[]) {
+    if(argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " writesData.ch8 writesCode.ch8" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // Fx33 into the bytes after the code, which it reads back with Fx65
+    check(run(argv[1], compiledROM_writesData), argv[1], "writes to data dropped the compiled code");
+
+    // Fx33 over its own jump
+    check(!run(argv[2], compiledROM_writesCode), argv[2], "writes to code kept the compiled code");
+
+    std::cout << failures << " failures" << std::endl;
+
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,217 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "compiledRom.hpp"
+#include "cpu.hpp"
+#include "randomRom.hpp"
+
+/// Runs ROMs on Dispatch::Table one instruction at a time, and on every
+/// other interpreter a frame at a time, and checks after each frame that
+/// they all reached the same state. The ROMs are random opcodes, plus
+/// opcodes whose decoding the backends once disagreed on and stacks that
+/// overflow and underflow. Random programs also run on Dispatch::Compiled,
+/// compiled by chip8-aot, see CMakeLists.txt.
+
+extern const CompiledROM compiledROM_random0;
+extern const CompiledROM compiledROM_random1;
+extern const CompiledROM compiledROM_random2;
+extern const CompiledROM compiledROM_random3;
+extern const CompiledROM compiledROM_random4;
+extern const CompiledROM compiledROM_random5;
+extern const CompiledROM compiledROM_random6;
+extern const CompiledROM compiledROM_random7;
+
+static const CompiledROM* const COMPILED_ROMS[] = {
+    &compiledROM_random0, &compiledROM_random1, &compiledROM_random2, &compiledROM_random3,
+    &compiledROM_random4, &compiledROM_random5, &compiledROM_random6, &compiledROM_random7
+};
+
+static const unsigned int COMPILED_ROM_COUNT = sizeof(COMPILED_ROMS) / sizeof(COMPILED_ROMS[0]);
+static const unsigned int RANDOM_ROMS = 200;
+static const unsigned int FRAMES = 200;
+static const unsigned int INSTRUCTIONS_PER_FRAME = 11;
+
+static const CPU::Dispatch CANDIDATES[] = {
+    CPU::Dispatch::Switch, CPU::Dispatch::Direct, CPU::Dispatch::Threaded,
+    CPU::Dispatch::Predecoded
+};
+
+// The last one is Dispatch::Compiled, for the ROMs compiled ahead of time
+static const char* const CANDIDATE_NAMES[] = {
+    "switch", "direct", "threaded", "predecoded", "compiled"
+};
+
+static const uint32_t PROFILES[] = {
+    Quirks::MODERN, Quirks::COSMAC_VIP, Quirks::SUPER_CHIP, Quirks::XO_CHIP
+};
+
+/// Returns false and reports the first frame where a backend diverged.
+/// `compiledROM` is the code of the ROM for Dispatch::Compiled, if any.
+static bool compare(const std::vector<uint8_t>& rom, uint32_t quirks, const char* name,
+                    const CompiledROM* compiledROM) {
+    CPU reference;
+    reference.setIdleSkipping(false);
+
+    std::vector<std::unique_ptr<CPU>> candidates;
+    for(CPU::Dispatch dispatch: CANDIDATES) {
+        candidates.emplace_back(new CPU());
+        candidates.back()->setDispatch(dispatch);
+    }
+
+    reference.loadROM(rom.data(), rom.size());
+    reference.setQuirks(quirks);
+
+    for(std::unique_ptr<CPU>& candidate: candidates) {
+        candidate->loadROM(rom.data(), rom.size());
+        candidate->setQuirks(quirks);
+    }
+
+    if(compiledROM) {
+        candidates.emplace_back(new CPU());
+        candidates.back()->setDispatch(CPU::Dispatch::Compiled);
+        candidates.back()->loadROM(rom.data(), rom.size());
+        candidates.back()->setQuirks(quirks);
+
+        if(!candidates.back()->setCompiledROM(compiledROM)) {
+            std::cerr << name << ": compiled code rejected" << std::endl;
+            return false;
+        }
+    }
+
+    for(unsigned int frame = 0; frame < FRAMES; ++frame) {
+        // Every key goes down and up, in a different order than the frames
+        uint8_t keys[16];
+        for(unsigned int key = 0; key < 16; ++key) {
+            keys[key] = ((frame * 7 + key * 3) % 11) < 4;
+        }
+
+        std::memcpy(reference.keyboard, keys, sizeof(keys));
+
+        for(unsigned int i = 0; i < INSTRUCTIONS_PER_FRAME; ++i) {
+            reference.runCycle();
+        }
+        reference.tickTimers();
+
+        CPUState expected;
+        reference.saveState(expected);
+
+        for(size_t i = 0; i < candidates.size(); ++i) {
+            CPU& candidate = *candidates[i];
+            std::memcpy(candidate.keyboard, keys, sizeof(keys));
+
+            candidate.runFrame(INSTRUCTIONS_PER_FRAME);
+
+            CPUState actual;
+            candidate.saveState(actual);
+
+            if(std::memcmp(&expected, &actual, sizeof(expected)) != 0) {
+                std::cerr << name << ", quirks " << quirks << ": " << CANDIDATE_NAMES[i]
+                          << " diverged from table at frame " << frame << ", pc " << std::hex
+                          << actual.pc << " instead of " << expected.pc << std::dec << std::endl;
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/// Returns false unless the ROM ends on the instruction at `pc`, with `sp`
+/// entries on the stack
+static bool halts(const std::vector<uint8_t>& rom, uint16_t pc, uint8_t sp, const char* name) {
+    CPU cpu;
+    cpu.loadROM(rom.data(), rom.size());
+
+    for(unsigned int frame = 0; frame < FRAMES; ++frame) {
+        cpu.runFrame(INSTRUCTIONS_PER_FRAME);
+    }
+
+    CPUState state;
+    cpu.saveState(state);
+
+    if(state.pc != pc || state.sp != sp) {
+        std::cerr << name << ": stopped at pc " << std::hex << state.pc << " instead of " << pc
+                  << std::dec << ", sp " << unsigned(state.sp) << " instead of " << unsigned(sp)
+                  << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+int main() {
+    std::vector<std::vector<uint8_t>> roms;
+    std::vector<std::string> names;
+
+    // Ex9E and ExA1 are decoded on their low nibble: E1F1 and E361 skip
+    // when a key is up, E2FE when it is down
+    roms.push_back({ 0x61, 0x05, 0xE1, 0xF1, 0x72, 0x01, 0xE3, 0x61, 0x73, 0x01,
+                     0xE1, 0x9E, 0x74, 0x01, 0xE1, 0x2E, 0x75, 0x01, 0x71, 0x01,
+                     0x12, 0x02 });
+    names.push_back("skip on key");
+
+    // Stores that wrap at the end of the ram: 5xy2 rewrites the jump at
+    // 0x000 that already ran, then Fx33 writes its last digit at 0x000
+    roms.push_back({ 0xA0, 0x00, 0x60, 0x12, 0x61, 0x0A, 0x50, 0x12, 0x10, 0x00,
+                     0xAF, 0xFF, 0x61, 0x12, 0x62, 0x14, 0x50, 0x22, 0x10, 0x00,
+                     0xAF, 0xFE, 0x60, 0x7B, 0xF0, 0x33, 0x12, 0x1A });
+    names.push_back("stores that wrap");
+
+    // A call with a full stack and a return with an empty one stay on
+    // their instruction, like 00FD: 20 calls to the next instruction, and
+    // a return to a stray 00EE
+    std::vector<uint8_t> recursion;
+    for(unsigned int i = 0; i < 20; ++i) {
+        recursion.push_back(0x22);
+        recursion.push_back(0x02 + 2 * i);
+    }
+    roms.push_back(recursion);
+    names.push_back("deep recursion");
+
+    std::vector<uint8_t> strayReturn = { 0x60, 0x01, 0x22, 0x08, 0x70, 0x01, 0x00, 0xEE,
+                                         0x70, 0x10, 0x00, 0xEE };
+    roms.push_back(strayReturn);
+    names.push_back("stray return");
+
+    size_t firstProgram = roms.size();
+    for(unsigned int i = 0; i < COMPILED_ROM_COUNT; ++i) {
+        roms.push_back(randomProgram(i));
+        names.push_back("random program " + std::to_string(i));
+    }
+
+    for(unsigned int i = 0; i < RANDOM_ROMS; ++i) {
+        roms.push_back(randomROM(i));
+        names.push_back("random ROM " + std::to_string(i));
+    }
+
+    unsigned int failures = 0;
+    failures += halts(recursion, 0x220, 16, "deep recursion") ? 0 : 1;
+    failures += halts(strayReturn, 0x206, 0, "stray return") ? 0 : 1;
+
+    for(size_t i = 0; i < roms.size(); ++i) {
+        for(uint32_t quirks: PROFILES) {
+            const CompiledROM* compiledROM = nullptr;
+            if(i >= firstProgram && i - firstProgram < COMPILED_ROM_COUNT) {
+                compiledROM = COMPILED_ROMS[i - firstProgram];
+            }
+
+            failures += compare(roms[i], quirks, names[i].c_str(), compiledROM) ? 0 : 1;
+        }
+    }
+
+    std::cout << roms.size() * (sizeof(PROFILES) / sizeof(PROFILES[0])) << " runs, "
+              << failures << " diverged" << std::endl;
+
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,180 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "framebuffer.hpp"
+#include "presenter.hpp"
+
+/// Presents the same frames with every kernel of the Presenter the CPU
+/// supports, and checks that they give the pixels of Framebuffer::expand
+/// without persistence, and the pixels of the scalar kernel with it. The
+/// frames are random planes in both resolutions, then sprites drawn and
+/// erased over a few rows, so that only some rows change or fade.
+
+static const unsigned int FRAMES = 120;
+static const unsigned int PERSISTENCES[] = { 0, 96, 160, 255 };
+
+static const Presenter::Kernel SIMD_KERNELS[] = {
+    Presenter::Kernel::SSE2, Presenter::Kernel::AVX2
+};
+
+static const char* const SIMD_KERNEL_NAMES[] = {
+    "sse2", "avx2"
+};
+
+// 8 rows for each plane, as drawSprite reads the rows of every selected
+// plane one after the other
+static const unsigned int SPRITE_HEIGHT = 8;
+static const uint8_t SPRITE[Framebuffer::PLANES * SPRITE_HEIGHT] = {
+    0xF0, 0x90, 0xF0, 0x90, 0x90, 0xFF, 0x81, 0x3C,
+    0x3C, 0x42, 0x81, 0x81, 0xFF, 0x18, 0x24, 0x42
+};
+
+static unsigned int failures = 0;
+
+static void randomize(Framebuffer& framebuffer, std::mt19937_64& random, bool hires) {
+    uint64_t bits[Framebuffer::PLANES][Framebuffer::WORDS][Framebuffer::HIRES_HEIGHT];
+    for(unsigned int plane = 0; plane < Framebuffer::PLANES; ++plane) {
+        for(unsigned int word = 0; word < Framebuffer::WORDS; ++word) {
+            for(unsigned int y = 0; y < Framebuffer::HIRES_HEIGHT; ++y) {
+                bits[plane][word][y] = random();
+            }
+        }
+    }
+
+    framebuffer.load(&bits[0][0][0], hires, Framebuffer::ALL_PLANES);
+}
+
+/// What the frame `frame` of a run changes on the display, the same for
+/// every kernel
+static void change(Framebuffer& framebuffer, std::mt19937_64& random, unsigned int frame) {
+    switch(frame % 8) {
+        case 0:
+            randomize(framebuffer, random, (frame / 8) % 2 == 1);
+            break;
+        case 1:
+        case 2:
+        case 5:
+            framebuffer.selectPlanes(1 + random() % Framebuffer::ALL_PLANES);
+            framebuffer.drawSprite(random() % framebuffer.width(), random() % framebuffer.height(),
+                                   SPRITE, SPRITE_HEIGHT);
+            break;
+        case 3:
+            framebuffer.clear();
+            break;
+        default:
+            // Nothing changes, rows only fade
+            break;
+    }
+}
+
+static bool same(const uint32_t* expected, const uint32_t* actual, unsigned int count,
+                 const char* kernel, unsigned int persistence, unsigned int frame) {
+    if(std::memcmp(expected, actual, count * sizeof(uint32_t)) == 0) {
+        return true;
+    }
+
+    unsigned int i = 0;
+    while(expected[i] == actual[i]) {
+        ++i;
+    }
+
+    std::cerr << kernel << ", persistence " << persistence << ": frame " << frame << ", pixel " << i
+              << " is " << std::hex << actual[i] << " instead of " << expected[i] << std::dec
+              << std::endl;
+    ++failures;
+    return false;
+}
+
+static void run(unsigned int persistence, const uint32_t* palette, uint64_t seed) {
+    std::vector<Presenter> presenters(1 + sizeof(SIMD_KERNELS) / sizeof(SIMD_KERNELS[0]));
+    std::vector<const char*> names = { "scalar" };
+
+    presenters[0].setKernel(Presenter::Kernel::Scalar);
+    for(size_t i = 0; i < sizeof(SIMD_KERNELS) / sizeof(SIMD_KERNELS[0]); ++i) {
+        if(!presenters[i + 1].setKernel(SIMD_KERNELS[i])) {
+            presenters.resize(i + 1);
+            break;
+        }
+
+        names.push_back(SIMD_KERNEL_NAMES[i]);
+    }
+
+    for(Presenter& presenter: presenters) {
+        presenter.setPalette(palette);
+        presenter.setPersistence(persistence);
+    }
+
+    Framebuffer framebuffer;
+    std::mt19937_64 random(seed);
+
+    for(unsigned int frame = 0; frame < FRAMES; ++frame) {
+        change(framebuffer, random, frame);
+
+        unsigned int begin = 0, end = 0;
+        bool changed = presenters[0].present(framebuffer, begin, end);
+        const uint32_t* scalar = presenters[0].getPixels();
+        unsigned int count = presenters[0].getWidth() * presenters[0].getHeight();
+
+        if(persistence == 0) {
+            std::vector<uint32_t> expanded(framebuffer.width() * framebuffer.height());
+            framebuffer.expand(expanded.data(), 0, framebuffer.height(), palette);
+
+            if(count != expanded.size()) {
+                std::cerr << "scalar: frame " << frame << " has " << count << " pixels instead of "
+                          << expanded.size() << std::endl;
+                ++failures;
+                return;
+            }
+
+            if(!same(expanded.data(), scalar, count, "scalar", persistence, frame)) {
+                return;
+            }
+        }
+
+        for(size_t i = 1; i < presenters.size(); ++i) {
+            unsigned int simdBegin = 0, simdEnd = 0;
+            bool simdChanged = presenters[i].present(framebuffer, simdBegin, simdEnd);
+
+            if(simdChanged != changed || (changed && (simdBegin != begin || simdEnd != end))) {
+                std::cerr << names[i] << ", persistence " << persistence << ": frame " << frame
+                          << " presented other rows than scalar" << std::endl;
+                ++failures;
+                return;
+            }
+
+            if(!same(scalar, presenters[i].getPixels(), count, names[i], persistence, frame)) {
+                return;
+            }
+        }
+    }
+}
+
+int main() {
+    // Colors whose channels differ, so that a channel mixed up or faded
+    // wrong shows
+    const uint32_t colors[1u << Framebuffer::PLANES] = { 0x10203040, 0xF0E0D0C0, 0x7F80FF01, 0xFFFFFFFF };
+
+    unsigned int runs = 0;
+    for(unsigned int persistence: PERSISTENCES) {
+        run(persistence, Framebuffer::PALETTE, 0x50524553 + persistence);
+        run(persistence, colors, 0x434F4C52 + persistence);
+        runs += 2;
+    }
+
+    std::cout << runs << " runs, kernel " << (Presenter::bestKernel() == Presenter::Kernel::AVX2 ? "avx2"
+                                              : Presenter::bestKernel() == Presenter::Kernel::SSE2 ? "sse2"
+                                              : "scalar")
+              << " at best, " << failures << " failures" << std::endl;
+
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
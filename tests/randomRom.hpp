@@ -0,0 +1,60 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#ifndef randomRom_hpp
+#define randomRom_hpp
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+static const unsigned int RANDOM_ROM_SIZE = 512;
+
+/// ROM `index` of the random ROMs of the checks, the same on every host,
+/// so that the build can compile some of them ahead of time
+inline std::vector<uint8_t> randomROM(unsigned int index) {
+    std::mt19937_64 random(0x43384454 + index);
+
+    std::vector<uint8_t> rom(RANDOM_ROM_SIZE);
+    for(uint8_t& byte: rom) {
+        byte = static_cast<uint8_t>(random());
+    }
+
+    return rom;
+}
+
+/// Random opcodes whose jumps and calls stay in their first half, and
+/// whose Annn point into their second half, so that most of the program
+/// is reachable code, e.g. for chip8-aot
+inline std::vector<uint8_t> randomProgram(unsigned int index) {
+    std::mt19937_64 random(0x50524F47 + index);
+
+    std::vector<uint8_t> rom(RANDOM_ROM_SIZE);
+    for(unsigned int address = 0; address < RANDOM_ROM_SIZE; address += 2) {
+        uint16_t opcode = static_cast<uint16_t>(random());
+
+        if(address < RANDOM_ROM_SIZE / 2) {
+            switch(opcode & 0xF000u) {
+                case 0x1000:
+                case 0x2000:
+                case 0xB000:
+                    opcode = (opcode & 0xF000u) | (0x200 + (opcode & (RANDOM_ROM_SIZE / 2 - 2)));
+                    break;
+                case 0xA000:
+                    opcode = 0xA000 | (0x200 + RANDOM_ROM_SIZE / 2 + (opcode & (RANDOM_ROM_SIZE / 2 - 1)));
+                    break;
+            }
+        }
+
+        rom[address] = opcode >> 8;
+        rom[address + 1] = opcode & 0x00FFu;
+    }
+
+    return rom;
+}
+
+#endif /* randomRom_hpp */
@@ -0,0 +1,118 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "cpu.hpp"
+#include "rewindBuffer.hpp"
+
+/// Records a ROM frame by frame in RewindBuffers, rewinds them to the
+/// oldest frame they kept and checks every frame against the state saved
+/// when it was recorded. The rings are small, so that their deltas wrap
+/// and the oldest are dropped, down to a ring smaller than a single delta.
+
+// Draws a sprite moving down and right, and writes the digits of a counter
+// into the ram, so every delta differs from the last
+static const uint8_t ROM[] = {
+    0xA2, 0x20, 0xD0, 0x15, 0x70, 0x03, 0x71, 0x01,
+    0xA3, 0x00, 0xF2, 0x33, 0x72, 0x07, 0x12, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0xF0, 0x90, 0xF0, 0x90, 0x90
+};
+
+static const unsigned int FRAMES = 300;
+static const unsigned int INSTRUCTIONS_PER_FRAME = 11;
+
+static unsigned int failures = 0;
+
+static void check(bool condition, const char* what) {
+    if(!condition) {
+        std::cerr << what << std::endl;
+        ++failures;
+    }
+}
+
+/// Records FRAMES frames in a ring of `capacity` bytes, then rewinds as far
+/// as it goes. Returns how many frames it rewound.
+static size_t roundTrip(size_t capacity) {
+    CPU cpu;
+    cpu.loadROM(ROM, sizeof(ROM));
+
+    RewindBuffer buffer(capacity);
+    std::vector<CPUState> states(FRAMES);
+
+    for(unsigned int frame = 0; frame < FRAMES; ++frame) {
+        cpu.saveState(states[frame]);
+        buffer.record(cpu);
+        check(buffer.memoryUsed() <= capacity, "the deltas overflowed the ring");
+
+        cpu.runFrame(INSTRUCTIONS_PER_FRAME);
+    }
+
+    size_t kept = buffer.frames();
+    size_t rewound = 0;
+
+    // The last frame recorded is the one before the last run
+    while(buffer.rewind(cpu)) {
+        ++rewound;
+
+        CPUState state;
+        cpu.saveState(state);
+
+        if(std::memcmp(&state, &states[FRAMES - 1 - rewound], sizeof(state)) != 0) {
+            std::cerr << "ring of " << capacity << " bytes: frame " << FRAMES - 1 - rewound
+                      << " differs once rewound" << std::endl;
+            ++failures;
+            return rewound;
+        }
+    }
+
+    check(rewound == kept, "rewound another number of frames than kept");
+    check(buffer.frames() == 0 && buffer.memoryUsed() == 0, "the ring is not empty once rewound");
+
+    return rewound;
+}
+
+int main() {
+    // Large enough for every frame
+    check(roundTrip(1 << 20) == FRAMES - 1, "a large ring dropped frames");
+
+    // A few dozen deltas: the ring wraps and drops the oldest
+    size_t rewound = roundTrip(2048);
+    check(rewound > 0 && rewound < FRAMES - 1, "a small ring did not drop its oldest frames");
+
+    // A delta larger than the ring empties it, and recording starts over
+    CPU cpu;
+    cpu.loadROM(ROM, sizeof(ROM));
+
+    RewindBuffer buffer(8);
+    buffer.record(cpu);
+    cpu.runFrame(INSTRUCTIONS_PER_FRAME);
+    buffer.record(cpu);
+    check(buffer.frames() == 0, "a delta larger than the ring was kept");
+    check(!buffer.rewind(cpu), "rewound a delta larger than the ring");
+
+    // The state it led to is kept, and an unchanged frame after it is a
+    // delta of a few bytes
+    CPUState expected;
+    cpu.saveState(expected);
+    buffer.record(cpu);
+    check(buffer.frames() == 1, "recording did not start over after a delta larger than the ring");
+    check(buffer.rewind(cpu), "cannot rewind after a delta larger than the ring");
+
+    CPUState state;
+    cpu.saveState(state);
+    check(std::memcmp(&state, &expected, sizeof(state)) == 0, "an unchanged frame differs once rewound");
+
+    std::cout << rewound << " frames kept by a ring of 2048 bytes, " << failures << " failures" << std::endl;
+
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,108 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include "cpu.hpp"
+#include "snapshotStore.hpp"
+
+/// Stores corrupt CPU states in a SnapshotStore, restores them from the
+/// mapping and checks that CPU::loadState rejects or masks them before
+/// they reach the CPU.
+
+static const uint8_t ROM[] = { 0x60, 0x2A, 0x22, 0x00 };
+
+static unsigned int failures = 0;
+
+static void check(bool condition, const char* what) {
+    if(!condition) {
+        std::cerr << what << std::endl;
+        ++failures;
+    }
+}
+
+/// Loads `state` into a CPU running ROM, and returns whether it was
+/// accepted. A rejected state must leave the CPU as it was.
+static bool load(const CPUState& state, CPU& cpu) {
+    cpu.loadROM(ROM, sizeof(ROM));
+
+    CPUState before, after;
+    cpu.saveState(before);
+
+    try {
+        cpu.loadState(state);
+    } catch(const std::runtime_error&) {
+        cpu.saveState(after);
+        check(std::memcmp(&before, &after, sizeof(before)) == 0, "a rejected state was partly loaded");
+        return false;
+    }
+
+    // One call and a frame, which wrote out of the stack before
+    cpu.runFrame(11);
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    if(argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " PathToStore" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::remove(argv[1]);
+
+    CPU cpu;
+    cpu.loadROM(ROM, sizeof(ROM));
+
+    CPUState valid;
+    cpu.saveState(valid);
+
+    {
+        SnapshotStore store(argv[1]);
+
+        CPUState state = valid;
+        state.sp = 28;
+        store.append(0, state);
+
+        state = valid;
+        state.planes = 4;
+        store.append(1, state);
+
+        state = valid;
+        state.pc = 0xF200;
+        state.I = 0x1234;
+        store.append(2, state);
+
+        state = valid;
+        state.sp = 16;
+        store.append(3, state);
+    }
+
+    SnapshotStore store(argv[1], false);
+
+    check(!load(*store.find(0), cpu), "a stack pointer past the stack was accepted");
+    check(!load(*store.find(1), cpu), "unknown planes were accepted");
+
+    check(load(*store.find(2), cpu), "addresses past the ram were rejected");
+    CPUState state;
+    CPU masked;
+    masked.loadState(*store.find(2));
+    masked.saveState(state);
+    check(state.pc == 0x200 && state.I == 0x234, "addresses past the ram were not masked");
+
+    // A full stack is valid, the call then halts
+    check(load(*store.find(3), cpu), "a full stack was rejected");
+
+    std::remove(argv[1]);
+
+    std::cout << failures << " failures" << std::endl;
+
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,34 @@
+//
+//  Chip-8
+//
+//  Created by Cosme Jordan on 12.09.20.
+//  Copyright © 2020 Cosme Jordan. All rights reserved.
+//
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "randomRom.hpp"
+
+/// Writes randomProgram(index) to a file, for chip8-aot to compile it
+
+int main(int argc, char* argv[]) {
+    if(argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " Index PathToROM" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<uint8_t> rom = randomProgram(std::stoi(argv[1]));
+
+    std::ofstream file(argv[2], std::ios::binary);
+    file.write(reinterpret_cast<const char*>(rom.data()), rom.size());
+
+    if(!file) {
+        std::cerr << "Error: cannot write " << argv[2] << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return 0;
+}